@@ -3,24 +3,58 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #ifndef NULL
 #define NULL 0
 #endif
 
+/// @brief The number of cleanup phases an arena supports (see PiggyBankArenaScheduleCleanupInPhase).
+/// @remark Every arena header, including those of child arenas, holds one pointer per phase. Define this as 1 before including the header to keep headers small when phases are not used.
+#ifndef PIGGYBANKARENA_CLEANUP_PHASES
+#define PIGGYBANKARENA_CLEANUP_PHASES 4
+#endif
+
 /// @brief A single cleanup action that the arena calls when cleaned up.
+/// @remark An action with a NULL func is skipped, along with the number of actions after it given in argument shifted right by one (which hold an inline payload). If the lowest bit of argument is set, the skipped actions hold a phased cleanup action.
 struct _PiggyBankArenaCleanupAction {
     void (*func)(void*);
     void *argument;
 };
 
+/// @brief A block of user-provided memory which holds cleanup actions separately from an arena's heap. It looks like this: [{Header} ... {<- Cleanup Action Stack (grows down)}]
+struct _PiggyBankArenaCleanupBlock {
+    struct _PiggyBankArenaCleanupBlock *previous;
+    void *end;
+    struct _PiggyBankArenaCleanupAction *cleanupActionsBottom;
+};
+
 /// @brief The arena occupies a user-provided chunk of memory. It looks like this: [{Header} {Heap (grows up) ->} ... {<- Cleanup Action Stack (grows down)}]
+/// @remark Phased cleanup actions are stored in the cleanup action stack too, and are additionally linked into one list per phase.
+/// @remark Once cleanup blocks are added to the arena, new cleanup actions are stored in the most recently added block instead of the arena's own memory.
+/// @remark The generation counts how often the arena was cleaned up, so that references into it can tell whether they are stale.
 struct PiggyBankArena {
     void *end;
     unsigned char *heapTop;
     struct _PiggyBankArenaCleanupAction *cleanupActionsBottom;
+    unsigned int generation;
+    struct _PiggyBankArenaCleanupAction *cleanupPhases[PIGGYBANKARENA_CLEANUP_PHASES];
+    struct _PiggyBankArenaCleanupBlock *cleanupBlocks;
     unsigned char start[];
 };
 
+/// @brief A cursor over memory reserved from an arena upfront. Allocating through it does no bounds checks.
+struct PiggyBankArenaCursor {
+    unsigned char *top;
+    unsigned char *end;
+};
+
+/// @brief A reference to memory in an arena, which can tell whether the arena was cleaned up since it was made. It is half the size of a pointer and a generation.
+struct PiggyBankArenaRef {
+    unsigned int offset;
+    unsigned int generation;
+};
+
 /// @brief Query how much space is remaining in an arena.
 /// @param arena A pointer to the arena.
 /// @returns the total space in bytes remaining in the arena (for both cleanup actions and the heap).
@@ -41,6 +75,11 @@ static inline struct PiggyBankArena *PiggyBankArenaInit(void* memory, unsigned l
     result->heapTop = (unsigned char*) memory + sizeof (struct PiggyBankArena);
     result->end = ((unsigned char*)result) + size;
     result->cleanupActionsBottom = (struct _PiggyBankArenaCleanupAction*) result->end;
+    result->generation = 0;
+    for (unsigned int phase = 0; phase < PIGGYBANKARENA_CLEANUP_PHASES; phase++) {
+        result->cleanupPhases[phase] = (struct _PiggyBankArenaCleanupAction*) NULL;
+    }
+    result->cleanupBlocks = (struct _PiggyBankArenaCleanupBlock*) NULL;
     return result;
 }
 
@@ -60,34 +99,349 @@ static inline void* PiggyBankArenaAlloc(struct PiggyBankArena* arena, unsigned l
     return result;
 }
 
+/// @brief Reserve space at the top of the heap without allocating it, so it can be written to directly.
+/// @remark The reserved memory stays valid until the next allocation or scheduled cleanup action. Call PiggyBankArenaCommit to allocate the part of it that was actually used.
+/// @param arena A pointer to the arena.
+/// @param maxSize The maximum number of bytes that will be written into the reserved memory.
+/// @returns a pointer to the reserved memory, or NULL if there is not enough space in the arena for the given size.
+static inline void* PiggyBankArenaReserve(struct PiggyBankArena* arena, unsigned long maxSize) {
+    if (PiggyBankArenaRemainingSpace(arena) < maxSize) {
+        return NULL;
+    }
+
+    return arena->heapTop;
+}
+
+/// @brief Allocate the first bytes of memory previously returned by PiggyBankArenaReserve.
+/// @param arena A pointer to the arena.
+/// @param size The number of bytes that were actually written into the reserved memory.
+/// @returns a pointer to the allocated memory (the same one PiggyBankArenaReserve returned), or NULL if there is not enough space in the arena for the given size.
+static inline void* PiggyBankArenaCommit(struct PiggyBankArena* arena, unsigned long size) {
+    return PiggyBankArenaAlloc(arena, size);
+}
+
+/// @brief Allocate a block of memory from an arena and return a cursor for allocating from it without further bounds checks.
+/// @remark Release the cursor with PiggyBankArenaReleaseCursor to give its unused memory back to the arena.
+/// @param arena A pointer to the arena.
+/// @param size The total amount of memory in bytes that will be allocated through the cursor.
+/// @returns a cursor over the reserved memory, or a cursor with NULL pointers if there is not enough space in the arena for the given size.
+static inline struct PiggyBankArenaCursor PiggyBankArenaReserveCursor(struct PiggyBankArena* arena, unsigned long size) {
+    struct PiggyBankArenaCursor result;
+    result.top = (unsigned char*) PiggyBankArenaAlloc(arena, size);
+    result.end = result.top ? result.top + size : (unsigned char*) NULL;
+    return result;
+}
+
+/// @brief Allocate memory through a cursor.
+/// @remark There are no bounds checks - the caller must not allocate more than the size the cursor was reserved with.
+/// @param cursor A pointer to the cursor.
+/// @param size The amount of memory in bytes.
+/// @returns a pointer to the allocated memory.
+static inline void* PiggyBankArenaCursorAlloc(struct PiggyBankArenaCursor* cursor, unsigned long size) {
+    void* result = cursor->top;
+    cursor->top += size;
+    return result;
+}
+
+/// @brief Release a cursor, giving its unused memory back to the arena.
+/// @remark The unused memory can only be given back if nothing else was allocated from the arena after the cursor was reserved. Otherwise it stays allocated until the arena is cleaned up.
+/// @param arena A pointer to the arena the cursor was reserved from.
+/// @param cursor A pointer to the cursor. It cannot be used for allocation afterwards.
+static inline void PiggyBankArenaReleaseCursor(struct PiggyBankArena* arena, struct PiggyBankArenaCursor* cursor) {
+    if (arena->heapTop == cursor->end) {
+        arena->heapTop = cursor->top;
+    }
+
+    cursor->end = cursor->top;
+}
+
+static inline struct _PiggyBankArenaCleanupAction* _PiggyBankArenaNextCleanupAction(struct _PiggyBankArenaCleanupAction* action) {
+    return action->func != NULL ? action + 1 : action + 1 + ((uintptr_t) action->argument >> 1);
+}
+
+static inline unsigned long _PiggyBankArenaCleanupBlockSpace(struct _PiggyBankArenaCleanupBlock* block) {
+    return ((unsigned char*) block->cleanupActionsBottom) - (unsigned char*) (block + 1);
+}
+
+static inline struct _PiggyBankArenaCleanupAction* _PiggyBankArenaPushCleanupActions(struct PiggyBankArena* arena, unsigned long count) {
+    struct _PiggyBankArenaCleanupBlock* block = arena->cleanupBlocks;
+    if (block != NULL) {
+        if (_PiggyBankArenaCleanupBlockSpace(block) / sizeof (struct _PiggyBankArenaCleanupAction) < count) {
+            return (struct _PiggyBankArenaCleanupAction*) NULL;
+        }
+
+        block->cleanupActionsBottom -= count;
+        return block->cleanupActionsBottom;
+    }
+
+    if (PiggyBankArenaRemainingSpace(arena) / sizeof (struct _PiggyBankArenaCleanupAction) < count) {
+        return (struct _PiggyBankArenaCleanupAction*) NULL;
+    }
+
+    arena->cleanupActionsBottom -= count;
+    return arena->cleanupActionsBottom;
+}
+
+/// @brief Add a block of memory which will hold the arena's cleanup actions from now on, so they no longer take up space in the arena itself.
+/// @remark When a block is full, scheduling cleanup actions fails until another block is added. The blocks are detached from the arena when it is cleaned up, after which the memory can be reused.
+/// @param arena A pointer to the arena.
+/// @param memory A pointer to the memory that will be used by the block.
+/// @param size The size of the memory in bytes.
+/// @returns a pointer to the initialized block, or NULL if the provided memory is not large enough.
+static inline struct _PiggyBankArenaCleanupBlock* PiggyBankArenaAddCleanupBlock(struct PiggyBankArena* arena, void* memory, unsigned long size) {
+    if (size <= sizeof (struct _PiggyBankArenaCleanupBlock)) {
+        return (struct _PiggyBankArenaCleanupBlock*) NULL;
+    }
+
+    struct _PiggyBankArenaCleanupBlock* block = (struct _PiggyBankArenaCleanupBlock*) memory;
+    block->previous = arena->cleanupBlocks;
+    block->end = ((unsigned char*) memory) + size;
+    block->cleanupActionsBottom = (struct _PiggyBankArenaCleanupAction*) block->end;
+    arena->cleanupBlocks = block;
+    return block;
+}
+
 /// @brief Schedule a cleanup function to be run when the arena is cleaned up.
 /// @param arena A pointer to the arena.
-/// @param cleanupFunction The function that will be called when the arena is cleaned up.
+/// @param cleanupFunction The function that will be called when the arena is cleaned up. It must not be NULL.
 /// @param argument An argument that will be passed to the cleanup function.
-/// @returns a pointer to the cleanup action that was scheduled on success, or NULL if there is not enough space in the arena for the given size.
+/// @returns a pointer to the cleanup action that was scheduled on success, or NULL if the cleanup function is NULL or there is not enough space in the arena for the given size.
 static inline struct _PiggyBankArenaCleanupAction* PiggyBankArenaScheduleCleanup(struct PiggyBankArena* arena, void (*cleanupFunction)(void*), void* argument) {
-    unsigned long remainingSpace = PiggyBankArenaRemainingSpace(arena);
-    if (remainingSpace < sizeof (struct _PiggyBankArenaCleanupAction)) {
+    if (cleanupFunction == NULL) {
         return (struct _PiggyBankArenaCleanupAction*) NULL;
     }
 
-    arena->cleanupActionsBottom--;
-    arena->cleanupActionsBottom->func = cleanupFunction;
-    arena->cleanupActionsBottom->argument = argument;
-    return arena->cleanupActionsBottom;
+    struct _PiggyBankArenaCleanupAction* action = _PiggyBankArenaPushCleanupActions(arena, 1);
+    if (action == NULL) {
+        return (struct _PiggyBankArenaCleanupAction*) NULL;
+    }
+
+    action->func = cleanupFunction;
+    action->argument = argument;
+    return action;
+}
+
+/// @brief Schedule a cleanup function to be run when the arena is cleaned up, with a payload that is stored inline in the cleanup action stack.
+/// @remark This avoids a separate allocation for cleanup functions which need more context than a single pointer.
+/// @param arena A pointer to the arena.
+/// @param cleanupFunction The function that will be called when the arena is cleaned up. It receives a pointer to the stored copy of the payload.
+/// @param payload A pointer to the payload, which is copied into the arena.
+/// @param payloadSize The size of the payload in bytes.
+/// @returns a pointer to the cleanup action that was scheduled on success, or NULL if there is not enough space in the arena for the cleanup action and payload.
+static inline struct _PiggyBankArenaCleanupAction* PiggyBankArenaScheduleCleanupWithPayload(struct PiggyBankArena* arena, void (*cleanupFunction)(void*), const void* payload, unsigned long payloadSize) {
+    if (cleanupFunction == NULL) {
+        return (struct _PiggyBankArenaCleanupAction*) NULL;
+    }
+
+    unsigned long payloadCount = (payloadSize + sizeof (struct _PiggyBankArenaCleanupAction) - 1) / sizeof (struct _PiggyBankArenaCleanupAction);
+    struct _PiggyBankArenaCleanupAction* action = _PiggyBankArenaPushCleanupActions(arena, 2 + payloadCount);
+    if (action == NULL) {
+        return (struct _PiggyBankArenaCleanupAction*) NULL;
+    }
+
+    for (unsigned long i = 0; i < payloadSize; i++) {
+        ((unsigned char*) (action + 2))[i] = ((const unsigned char*) payload)[i];
+    }
+
+    action[1].func = NULL;
+    action[1].argument = (void*) (uintptr_t) (payloadCount << 1);
+    action->func = cleanupFunction;
+    action->argument = action + 2;
+    return action;
+}
+
+/// @brief Schedule a cleanup function to be run in a given phase when the arena is cleaned up.
+/// @remark Phases run in ascending order, before all cleanup actions which were not scheduled in a phase. Within a phase, cleanup actions run in last-in-first-out order.
+/// @param arena A pointer to the arena.
+/// @param phase The phase, which must be less than PIGGYBANKARENA_CLEANUP_PHASES.
+/// @param cleanupFunction The function that will be called when the arena is cleaned up.
+/// @param argument An argument that will be passed to the cleanup function.
+/// @returns a pointer to the cleanup action that was scheduled on success, or NULL if the phase is invalid or there is not enough space in the arena.
+static inline struct _PiggyBankArenaCleanupAction* PiggyBankArenaScheduleCleanupInPhase(struct PiggyBankArena* arena, unsigned int phase, void (*cleanupFunction)(void*), void* argument) {
+    if (cleanupFunction == NULL || phase >= PIGGYBANKARENA_CLEANUP_PHASES) {
+        return (struct _PiggyBankArenaCleanupAction*) NULL;
+    }
+
+    struct _PiggyBankArenaCleanupAction* marker = _PiggyBankArenaPushCleanupActions(arena, 3);
+    if (marker == NULL) {
+        return (struct _PiggyBankArenaCleanupAction*) NULL;
+    }
+
+    marker->func = NULL;
+    marker->argument = (void*) (uintptr_t) ((2UL << 1) | 1);
+    marker[1].func = cleanupFunction;
+    marker[1].argument = argument;
+    marker[2].func = NULL;
+    marker[2].argument = arena->cleanupPhases[phase];
+    arena->cleanupPhases[phase] = marker + 1;
+    return marker + 1;
+}
+
+/// @brief Cancel a scheduled cleanup action, so it does not run when the arena is cleaned up.
+/// @remark This takes amortized O(1) time. If the action is the most recently scheduled one (and not a phased one), its space is given back to the arena right away. The action must not be used afterwards.
+/// @param arena A pointer to the arena.
+/// @param action A pointer to the cleanup action, as returned when it was scheduled.
+static inline void PiggyBankArenaCancelCleanup(struct PiggyBankArena* arena, struct _PiggyBankArenaCleanupAction* action) {
+    action->func = NULL;
+    action->argument = NULL;
+
+    struct _PiggyBankArenaCleanupAction** bottom = arena->cleanupBlocks ? &arena->cleanupBlocks->cleanupActionsBottom : &arena->cleanupActionsBottom;
+    void* end = arena->cleanupBlocks ? arena->cleanupBlocks->end : arena->end;
+    while (*bottom < (struct _PiggyBankArenaCleanupAction*) end && (*bottom)->func == NULL && !((uintptr_t) (*bottom)->argument & 1)) {
+        *bottom = _PiggyBankArenaNextCleanupAction(*bottom);
+    }
+}
+
+static inline void _PiggyBankArenaRunCleanupActions(struct _PiggyBankArenaCleanupAction* action, void* end) {
+    while (action < (struct _PiggyBankArenaCleanupAction*) end) {
+        if (action->func != NULL) {
+            action->func(action->argument);
+            action++;
+        } else {
+            action += 1 + ((uintptr_t) action->argument >> 1);
+        }
+    }
 }
 
 /// @brief Clean up the given arena by calling all registered cleanup functions and resetting the arena to an empty state. 
 /// @remark After this, the arena can be reused again, as if it was just created.
 /// @param arena A pointer to the arena.
 static inline void PiggyBankArenaCleanup(struct PiggyBankArena* arena) {
-    struct _PiggyBankArenaCleanupAction* action = arena->cleanupActionsBottom;
-    
-    while (action < arena->end) {
-        action->func(action->argument);
-        action++;
+    for (unsigned int phase = 0; phase < PIGGYBANKARENA_CLEANUP_PHASES; phase++) {
+        struct _PiggyBankArenaCleanupAction* phaseAction = arena->cleanupPhases[phase];
+        while (phaseAction != NULL) {
+            if (phaseAction->func != NULL) {
+                phaseAction->func(phaseAction->argument);
+            }
+            phaseAction = (struct _PiggyBankArenaCleanupAction*) phaseAction[1].argument;
+        }
+        arena->cleanupPhases[phase] = (struct _PiggyBankArenaCleanupAction*) NULL;
+    }
+
+    struct _PiggyBankArenaCleanupBlock* block = arena->cleanupBlocks;
+    while (block != NULL) {
+        struct _PiggyBankArenaCleanupBlock* previous = block->previous;
+        _PiggyBankArenaRunCleanupActions(block->cleanupActionsBottom, block->end);
+        block = previous;
     }
 
+    _PiggyBankArenaRunCleanupActions(arena->cleanupActionsBottom, arena->end);
+
     arena->heapTop = arena->start;
     arena->cleanupActionsBottom = (struct _PiggyBankArenaCleanupAction*) arena->end;
+    arena->cleanupBlocks = (struct _PiggyBankArenaCleanupBlock*) NULL;
+    arena->generation++;
+}
+
+/// @brief Make a reference to memory in an arena, which stops resolving once the arena is cleaned up.
+/// @remark Only memory in the first 4 GiB of the arena can be referenced. The generation wraps around after 2^32 cleanups, so a reference that old could resolve again.
+/// @param arena A pointer to the arena.
+/// @param pointer A pointer to memory allocated from the arena, or NULL.
+/// @returns the reference, which resolves to NULL if the pointer is NULL or too far from the start of the arena.
+static inline struct PiggyBankArenaRef PiggyBankArenaMakeRef(struct PiggyBankArena* arena, void* pointer) {
+    unsigned long long offset = pointer ? (unsigned long long) ((unsigned char*) pointer - (unsigned char*) arena) : 0;
+    struct PiggyBankArenaRef result;
+    result.offset = offset == (unsigned int) offset ? (unsigned int) offset : 0;
+    result.generation = arena->generation;
+    return result;
+}
+
+/// @brief Get the memory a reference points to, unless the arena was cleaned up since the reference was made.
+/// @param arena A pointer to the arena the reference was made from.
+/// @param ref The reference.
+/// @returns a pointer to the memory, or NULL if the reference is stale or points to NULL.
+static inline void* PiggyBankArenaResolveRef(struct PiggyBankArena* arena, struct PiggyBankArenaRef ref) {
+    if (ref.generation != arena->generation || ref.offset == 0) {
+        return NULL;
+    }
+
+    return (unsigned char*) arena + ref.offset;
+}
+
+static inline void _PiggyBankArenaCleanupChild(void* child) {
+    PiggyBankArenaCleanup((struct PiggyBankArena*) child);
+}
+
+/// @brief Make an arena take ownership of another arena, so that cleaning it up also cleans up the other one. Nothing is copied.
+/// @remark This is useful for gathering the arenas of parallel workers into one arena which is then cleaned up once.
+/// @param owner A pointer to the arena that takes ownership.
+/// @param other A pointer to the arena that will be owned.
+/// @param freeMemory A function that will be called with the other arena's memory after it has been cleaned up (e.g. free), or NULL if the memory is not owned.
+/// @returns a pointer to the cleanup action that was scheduled on success, or NULL if there is not enough space in the owning arena.
+static inline struct _PiggyBankArenaCleanupAction* PiggyBankArenaAdopt(struct PiggyBankArena* owner, struct PiggyBankArena* other, void (*freeMemory)(void*)) {
+    struct _PiggyBankArenaCleanupAction* freeAction = (struct _PiggyBankArenaCleanupAction*) NULL;
+    if (freeMemory != NULL) {
+        freeAction = PiggyBankArenaScheduleCleanup(owner, freeMemory, other);
+        if (freeAction == NULL) {
+            return (struct _PiggyBankArenaCleanupAction*) NULL;
+        }
+    }
+
+    struct _PiggyBankArenaCleanupAction* result = PiggyBankArenaScheduleCleanup(owner, &_PiggyBankArenaCleanupChild, other);
+    if (result == NULL && freeAction != NULL) {
+        PiggyBankArenaCancelCleanup(owner, freeAction);
+    }
+
+    return result;
+}
+
+/// @brief Create a child arena inside memory allocated from a parent arena. The child is cleaned up along with the parent.
+/// @remark The child can be cleaned up and reused on its own any number of times during the parent's lifetime.
+/// @param parent A pointer to the parent arena.
+/// @param size The size of the child arena's memory in bytes.
+/// @returns a pointer to the initialized child arena, or NULL if there is not enough space in the parent arena or the size is too small for an arena.
+static inline struct PiggyBankArena* PiggyBankArenaMakeChild(struct PiggyBankArena* parent, unsigned long size) {
+    void* memory = PiggyBankArenaAlloc(parent, size);
+    if (memory == NULL) {
+        return (struct PiggyBankArena*) NULL;
+    }
+
+    struct PiggyBankArena* child = PiggyBankArenaInit(memory, size);
+    if (child == NULL || !PiggyBankArenaAdopt(parent, child, NULL)) {
+        parent->heapTop -= size;
+        return (struct PiggyBankArena*) NULL;
+    }
+
+    return child;
+}
+
+/// @brief Split all of the remaining space in an arena into equally sized child arenas, e.g. to hand them off to worker threads.
+/// @remark The children's cleanup is scheduled on the parent right away, so joining the workers needs no further calls. The children can be used concurrently with each other, but the parent must not be cleaned up while they are still in use.
+/// @remark The children's headers are aligned like the parent's, so a few bytes of the remaining space may be left unused.
+/// @param arena A pointer to the arena that will be split.
+/// @param count The number of child arenas to create.
+/// @param children An array which receives the pointers to the child arenas. It must have room for at least count elements.
+/// @returns the number of child arenas created (either count or 0 if there is not enough space in the arena for that many).
+static inline unsigned long PiggyBankArenaSplit(struct PiggyBankArena* arena, unsigned long count, struct PiggyBankArena** children) {
+    if (count == 0) {
+        return 0;
+    }
+
+    // The children's headers are aligned like the parent's, whose strictest members are pointers
+    const unsigned long alignment = sizeof (void*);
+    unsigned long padding = (alignment - (unsigned long) (arena->heapTop - (unsigned char*) arena) % alignment) % alignment;
+    if (PiggyBankArenaRemainingSpace(arena) < padding) {
+        return 0;
+    }
+
+    unsigned long childSize = (PiggyBankArenaRemainingSpace(arena) - padding) / count;
+    if (childSize <= sizeof (struct _PiggyBankArenaCleanupAction)) {
+        return 0;
+    }
+
+    childSize = (childSize - sizeof (struct _PiggyBankArenaCleanupAction)) / alignment * alignment;
+    if (childSize <= sizeof (struct PiggyBankArena)) {
+        return 0;
+    }
+
+    if (arena->cleanupBlocks != NULL && _PiggyBankArenaCleanupBlockSpace(arena->cleanupBlocks) / sizeof (struct _PiggyBankArenaCleanupAction) < count) {
+        return 0;
+    }
+
+    PiggyBankArenaAlloc(arena, padding);
+    for (unsigned long i = 0; i < count; i++) {
+        children[i] = PiggyBankArenaMakeChild(arena, childSize);
+    }
+
+    return count;
 }
\ No newline at end of file
@@ -3,19 +3,46 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include <new>
+
+/// @brief The number of cleanup phases an arena supports (see PiggyBankArena::scheduleCleanup).
+/// @remark Every arena header, including those of child arenas, holds one pointer per phase. Define this as 1 before including the header to keep headers small when phases are not used.
+#ifndef PIGGYBANKARENA_CLEANUP_PHASES
+#define PIGGYBANKARENA_CLEANUP_PHASES 4
+#endif
+
 namespace PiggyBankArena {
 
 /// @brief A single cleanup action that the arena calls when cleaned up.
+/// @remark An action with a NULL func is skipped, along with the number of actions after it given in argument shifted right by one (which hold an inline payload). If the lowest bit of argument is set, the skipped actions hold a phased cleanup action.
 struct _PiggyBankArenaCleanupAction {
     void (*func)(void*);
     void *argument;
 };
 
+struct PiggyBankArenaCursor;
+template <typename T> struct ArenaRef;
+
+/// @brief A block of user-provided memory which holds cleanup actions separately from an arena's heap. It looks like this: [{Header} ... {<- Cleanup Action Stack (grows down)}]
+struct _PiggyBankArenaCleanupBlock {
+    struct _PiggyBankArenaCleanupBlock *previous;
+    void *end;
+    struct _PiggyBankArenaCleanupAction *cleanupActionsBottom;
+};
+
 /// @brief The arena occupies a user-provided chunk of memory. It looks like this: [{Header} {Heap (grows up) ->} ... {<- Cleanup Action Stack (grows down)}]
+/// @remark Phased cleanup actions are stored in the cleanup action stack too, and are additionally linked into one list per phase.
+/// @remark Once cleanup blocks are added to the arena, new cleanup actions are stored in the most recently added block instead of the arena's own memory.
+/// @remark The generation counts how often the arena was cleaned up, so that references into it can tell whether they are stale.
 struct PiggyBankArena {
     void *end;
     unsigned char *heapTop;
     struct _PiggyBankArenaCleanupAction *cleanupActionsBottom;
+    unsigned int generation;
+    struct _PiggyBankArenaCleanupAction *cleanupPhases[PIGGYBANKARENA_CLEANUP_PHASES];
+    struct _PiggyBankArenaCleanupBlock *cleanupBlocks;
     unsigned char start[];
 
 public:
@@ -36,6 +63,11 @@ public:
         result->heapTop = (unsigned char*) memory + sizeof (struct PiggyBankArena);
         result->end = ((unsigned char*)result) + size;
         result->cleanupActionsBottom = (struct _PiggyBankArenaCleanupAction*) result->end;
+        result->generation = 0;
+        for (unsigned int phase = 0; phase < PIGGYBANKARENA_CLEANUP_PHASES; phase++) {
+            result->cleanupPhases[phase] = nullptr;
+        }
+        result->cleanupBlocks = nullptr;
         return result;
     }
 
@@ -58,19 +90,187 @@ public:
         return result;
     }
 
+    /// @brief Reserve space at the top of the heap without allocating it, so it can be written to directly.
+    /// @remark The reserved memory stays valid until the next allocation or scheduled cleanup action. Call commit() to allocate the part of it that was actually used.
+    /// @param maxSize The maximum number of bytes that will be written into the reserved memory.
+    /// @returns a pointer to the reserved memory, or NULL if there is not enough space in the arena for the given size.
+    inline void* reserve(unsigned long maxSize) {
+        if (this->remainingSpace() < maxSize) {
+            return nullptr;
+        }
+
+        return this->heapTop;
+    }
+
+    /// @brief Allocate the first bytes of memory previously returned by reserve().
+    /// @param size The number of bytes that were actually written into the reserved memory.
+    /// @returns a pointer to the allocated memory (the same one reserve() returned), or NULL if there is not enough space in the arena for the given size.
+    inline void* commit(unsigned long size) {
+        return this->alloc(size);
+    }
+
+    /// @brief Allocate a block of memory from the arena and return a cursor for allocating from it without further bounds checks.
+    /// @remark Release the cursor with its release() method to give its unused memory back to the arena.
+    /// @param size The total amount of memory in bytes that will be allocated through the cursor.
+    /// @returns a cursor over the reserved memory, or a cursor with NULL pointers if there is not enough space in the arena for the given size.
+    inline struct PiggyBankArenaCursor reserveCursor(unsigned long size);
+
     /// @brief Schedule a cleanup function to be run when the arena is cleaned up.
-    /// @param cleanupFunction The function that will be called when the arena is cleaned up.
+    /// @param cleanupFunction The function that will be called when the arena is cleaned up. It must not be NULL.
     /// @param argument An argument that will be passed to the cleanup function.
-    /// @returns a pointer to the cleanup action that was scheduled on success, or NULL if there is not enough space in the arena for the given size.
+    /// @returns a pointer to the cleanup action that was scheduled on success, or NULL if the cleanup function is NULL or there is not enough space in the arena for the given size.
     inline struct _PiggyBankArenaCleanupAction* scheduleCleanup(void (*cleanupFunction)(void*), void* argument) {
-        if (this->remainingSpace() < sizeof (struct _PiggyBankArenaCleanupAction)) {
-            return (struct _PiggyBankArenaCleanupAction*) nullptr;
+        if (cleanupFunction == nullptr) {
+            return nullptr;
         }
 
-        this->cleanupActionsBottom--;
-        this->cleanupActionsBottom->func = cleanupFunction;
-        this->cleanupActionsBottom->argument = argument;
-        return this->cleanupActionsBottom;
+        struct _PiggyBankArenaCleanupAction* action = this->_pushCleanupActions(1);
+        if (action == nullptr) {
+            return nullptr;
+        }
+
+        action->func = cleanupFunction;
+        action->argument = argument;
+        return action;
+    }
+
+    /// @brief Schedule a cleanup function to be run in a given phase when the arena is cleaned up.
+    /// @remark Phases run in ascending order, before all cleanup actions which were not scheduled in a phase. Within a phase, cleanup actions run in last-in-first-out order.
+    /// @param cleanupFunction The function that will be called when the arena is cleaned up.
+    /// @param argument An argument that will be passed to the cleanup function.
+    /// @param phase The phase, which must be less than PIGGYBANKARENA_CLEANUP_PHASES.
+    /// @returns a pointer to the cleanup action that was scheduled on success, or NULL if the phase is invalid or there is not enough space in the arena.
+    inline struct _PiggyBankArenaCleanupAction* scheduleCleanup(void (*cleanupFunction)(void*), void* argument, unsigned int phase) {
+        if (cleanupFunction == nullptr || phase >= PIGGYBANKARENA_CLEANUP_PHASES) {
+            return nullptr;
+        }
+
+        struct _PiggyBankArenaCleanupAction* marker = this->_pushCleanupActions(3);
+        if (marker == nullptr) {
+            return nullptr;
+        }
+
+        marker->func = nullptr;
+        marker->argument = (void*) (uintptr_t) ((2UL << 1) | 1);
+        marker[1].func = cleanupFunction;
+        marker[1].argument = argument;
+        marker[2].func = nullptr;
+        marker[2].argument = this->cleanupPhases[phase];
+        this->cleanupPhases[phase] = marker + 1;
+        return marker + 1;
+    }
+
+    /// @brief Schedule a cleanup function which does not depend on the order it runs in relative to other cleanup actions.
+    /// @remark cleanup() runs it in last-in-first-out order like any other cleanup action, but parallelCleanup() (see PiggyBankArenaThreadsCPP.hpp) may run it on a worker thread, concurrently with other independent cleanup actions.
+    /// @param cleanupFunction The function that will be called when the arena is cleaned up.
+    /// @param argument An argument that will be passed to the cleanup function.
+    /// @returns a pointer to the cleanup action that was scheduled on success, or NULL if there is not enough space in the arena.
+    inline struct _PiggyBankArenaCleanupAction* scheduleIndependentCleanup(void (*cleanupFunction)(void*), void* argument) {
+        if (cleanupFunction == nullptr) {
+            return nullptr;
+        }
+
+        struct _PiggyBankArenaCleanupAction* action = this->_pushPayloadCleanupAction(&PiggyBankArena::_runIndependentCleanup, sizeof (struct _PiggyBankArenaCleanupAction));
+        if (action == nullptr) {
+            return nullptr;
+        }
+
+        ((struct _PiggyBankArenaCleanupAction*) action->argument)->func = cleanupFunction;
+        ((struct _PiggyBankArenaCleanupAction*) action->argument)->argument = argument;
+        return action;
+    }
+
+    /// @brief Schedule a cleanup function to be run when the arena is cleaned up, with a payload that is stored inline in the cleanup action stack.
+    /// @remark This avoids a separate allocation for cleanup functions which need more context than a single pointer.
+    /// @param cleanupFunction The function that will be called when the arena is cleaned up. It receives a pointer to the stored copy of the payload.
+    /// @param payload A pointer to the payload, which is copied into the arena.
+    /// @param payloadSize The size of the payload in bytes.
+    /// @returns a pointer to the cleanup action that was scheduled on success, or NULL if there is not enough space in the arena for the cleanup action and payload.
+    inline struct _PiggyBankArenaCleanupAction* scheduleCleanupWithPayload(void (*cleanupFunction)(void*), const void* payload, unsigned long payloadSize) {
+        if (cleanupFunction == nullptr) {
+            return nullptr;
+        }
+
+        struct _PiggyBankArenaCleanupAction* action = this->_pushPayloadCleanupAction(cleanupFunction, payloadSize);
+        if (action == nullptr) {
+            return nullptr;
+        }
+
+        for (unsigned long i = 0; i < payloadSize; i++) {
+            ((unsigned char*) action->argument)[i] = ((const unsigned char*) payload)[i];
+        }
+
+        return action;
+    }
+
+    /// @brief Schedule a function object (e.g. a lambda) to be called when the arena is cleaned up. The function object is stored inline in the cleanup action stack.
+    /// @tparam F The type of the function object.
+    /// @param function The function object, which is moved into the arena and destroyed after it is called.
+    /// @returns a pointer to the cleanup action that was scheduled on success, or NULL if there is not enough space in the arena for the cleanup action and function object.
+    template <typename F> inline struct _PiggyBankArenaCleanupAction* defer(F function) {
+        static_assert(alignof(F) <= alignof(struct _PiggyBankArenaCleanupAction), "The function object must not need a stricter alignment than a cleanup action.");
+        struct _PiggyBankArenaCleanupAction* action = this->_pushPayloadCleanupAction(&PiggyBankArena::_runDeferred<F>, sizeof(F));
+        if (action == nullptr) {
+            return nullptr;
+        }
+
+        new (action->argument) F(static_cast<F&&>(function));
+        return action;
+    }
+
+    /// @brief Cancel a scheduled cleanup action, so it does not run when the arena is cleaned up.
+    /// @remark This takes amortized O(1) time. If the action is the most recently scheduled one (and not a phased one), its space is given back to the arena right away. The action must not be used afterwards.
+    /// @remark Function objects scheduled with defer() are not destroyed when they are cancelled this way, use cancelDeferred() for them.
+    /// @param action A pointer to the cleanup action, as returned when it was scheduled.
+    inline void cancelCleanup(struct _PiggyBankArenaCleanupAction* action) {
+        action->func = nullptr;
+        action->argument = nullptr;
+
+        struct _PiggyBankArenaCleanupAction*& bottom = this->_cleanupStackBottom();
+        void* end = this->_cleanupStackEnd();
+        while (bottom < end && bottom->func == nullptr && !((uintptr_t) bottom->argument & 1)) {
+            bottom = PiggyBankArena::_nextCleanupAction(bottom);
+        }
+    }
+
+    /// @brief Cancel a function object scheduled with defer(), destroying it without calling it.
+    /// @remark This works like cancelCleanup(), so the same remarks apply.
+    /// @tparam F The type of the function object, which must be the one it was scheduled with.
+    /// @param action A pointer to the cleanup action, as returned by defer().
+    template <typename F> inline void cancelDeferred(struct _PiggyBankArenaCleanupAction* action) {
+        ((F*) action->argument)->~F();
+        this->cancelCleanup(action);
+    }
+
+    /// @brief Get the argument of the most recently scheduled cleanup action, if it was scheduled with the given cleanup function.
+    /// @remark This allows extending the most recent cleanup action instead of scheduling another one, e.g. to release many resources with one cleanup action. For cleanup actions with a payload, the argument points to the payload.
+    /// @param cleanupFunction The cleanup function the most recent cleanup action must have.
+    /// @returns the argument of the most recent cleanup action, or NULL if there is none or it has a different cleanup function.
+    inline void* lastCleanupArgument(void (*cleanupFunction)(void*)) {
+        struct _PiggyBankArenaCleanupAction* action = this->_cleanupStackBottom();
+        if (action < this->_cleanupStackEnd() && action->func == cleanupFunction) {
+            return action->argument;
+        }
+
+        return nullptr;
+    }
+
+    /// @brief Add a block of memory which will hold the arena's cleanup actions from now on, so they no longer take up space in the arena itself.
+    /// @remark When a block is full, scheduling cleanup actions fails until another block is added. The blocks are detached from the arena when it is cleaned up, after which the memory can be reused.
+    /// @param memory A pointer to the memory that will be used by the block.
+    /// @param size The size of the memory in bytes.
+    /// @returns a pointer to the initialized block, or NULL if the provided memory is not large enough.
+    inline struct _PiggyBankArenaCleanupBlock* addCleanupBlock(void* memory, unsigned long size) {
+        if (size <= sizeof (struct _PiggyBankArenaCleanupBlock)) {
+            return nullptr;
+        }
+
+        struct _PiggyBankArenaCleanupBlock* block = (struct _PiggyBankArenaCleanupBlock*) memory;
+        block->previous = this->cleanupBlocks;
+        block->end = ((unsigned char*) memory) + size;
+        block->cleanupActionsBottom = (struct _PiggyBankArenaCleanupAction*) block->end;
+        this->cleanupBlocks = block;
+        return block;
     }
 
     /// @brief Allocate space for a C++ object onto the arena.
@@ -94,22 +294,318 @@ public:
         return result;
     }
 
+    /// @brief Allocate space for an array of C++ objects onto the arena.
+    /// @remark All destructors of the array are called by a single cleanup action, in reverse order.
+    /// @tparam T The type of the objects to allocate.
+    /// @param count The number of objects in the array.
+    /// @param callDestructorOnCleanup Whether the destructors should be called when the arena is cleaned up.
+    /// @returns a pointer to the first allocated object, or NULL if there is insufficient space.
+    template <typename T> inline T* allocArray(unsigned long count, bool callDestructorOnCleanup = true) {
+        if (count > this->remainingSpace() / sizeof(T)) {
+            return nullptr;
+        }
+
+        T* result = (T*) this->alloc(count * sizeof(T));
+
+        if (result == nullptr) {
+            return nullptr;
+        }
+
+        if (callDestructorOnCleanup) {
+            if (!this->scheduleDestroyObjects<T>(result, count)) {
+                this->heapTop -= count * sizeof(T);
+                return nullptr;
+            }
+        }
+
+        return result;
+    }
+
+    /// @brief Allocate space for a C++ object onto the arena, grouping its destructor with those of objects of the same type allocated right before it.
+    /// @remark Consecutive objects of the same type share a single cleanup action, which calls their destructors in a tight loop (in reverse order). This makes both allocation and cleanup of many objects much cheaper than with allocObject.
+    /// @tparam T The type of the object to allocate.
+    /// @returns a pointer to the allocated object, or NULL if there is insufficient space.
+    template <typename T> inline T* allocObjectGrouped() {
+        T* result = (T*) this->alloc(sizeof(T));
+
+        if (result == nullptr) {
+            return nullptr;
+        }
+
+        // Groups have their own cleanup function, so runs which containers resize are never extended
+        struct _ObjectGroup* group = (struct _ObjectGroup*) this->lastCleanupArgument(&PiggyBankArena::_destroyObjectGroup<T>);
+        if (group != nullptr && group->end == result) {
+            group->end = result + 1;
+            return result;
+        }
+
+        struct _PiggyBankArenaCleanupAction* action = this->_pushPayloadCleanupAction(&PiggyBankArena::_destroyObjectGroup<T>, sizeof (struct _ObjectGroup));
+        if (action == nullptr) {
+            this->heapTop -= sizeof(T);
+            return nullptr;
+        }
+
+        ((struct _ObjectGroup*) action->argument)->first = result;
+        ((struct _ObjectGroup*) action->argument)->end = result + 1;
+        return result;
+    }
+
+    /// @brief Schedule the destructors of consecutive C++ objects to be called by a single cleanup action, in reverse order.
+    /// @remark The returned count can be changed until the arena is cleaned up, e.g. by containers which construct and destroy their objects one by one. Objects allocated with allocObjectGrouped() never join such a run.
+    /// @tparam T The type of the objects.
+    /// @param first A pointer to the first object.
+    /// @param count The number of objects whose destructors will be called.
+    /// @returns a pointer to the number of objects whose destructors will be called, or NULL if there is not enough space.
+    template <typename T> inline unsigned long* scheduleDestroyObjects(T* first, unsigned long count) {
+        struct _PiggyBankArenaCleanupAction* action = this->_pushPayloadCleanupAction(&PiggyBankArena::_destroyObjectRun<T>, sizeof (struct _ObjectRun));
+        if (action == nullptr) {
+            return nullptr;
+        }
+
+        ((struct _ObjectRun*) action->argument)->first = first;
+        ((struct _ObjectRun*) action->argument)->count = count;
+        return &((struct _ObjectRun*) action->argument)->count;
+    }
+
+    /// @brief Change where the objects of a cleanup action scheduled with scheduleDestroyObjects are, e.g. after they were moved to a new buffer.
+    /// @remark This reuses the existing cleanup action, so moving objects around does not take up more space in the cleanup action stack.
+    /// @tparam T The type of the objects.
+    /// @param count The pointer returned by scheduleDestroyObjects.
+    /// @param first A pointer to the new first object.
+    template <typename T> inline void moveDestroyObjects(unsigned long* count, T* first) {
+        ((struct _ObjectRun*) count)->first = first;
+    }
+
     /// @brief Clean up the given arena by calling all registered cleanup functions and resetting the arena to an empty state. 
     /// @remark After this, the arena can be reused again, as if it was just created.
     /// @param arena A pointer to the arena.
     inline void cleanup() {
-        struct _PiggyBankArenaCleanupAction* action = this->cleanupActionsBottom;
-        
-        while (action < this->end) {
-            action->func(action->argument);
-            action++;
+        this->_runCleanupPhases();
+
+        struct _PiggyBankArenaCleanupBlock* block = this->cleanupBlocks;
+        while (block != nullptr) {
+            struct _PiggyBankArenaCleanupBlock* previous = block->previous;
+            PiggyBankArena::_runCleanupActions(block->cleanupActionsBottom, block->end);
+            block = previous;
         }
 
+        PiggyBankArena::_runCleanupActions(this->cleanupActionsBottom, this->end);
+
         this->heapTop = this->start;
         this->cleanupActionsBottom = (struct _PiggyBankArenaCleanupAction*) this->end;
+        this->cleanupBlocks = nullptr;
+        this->generation++;
+    }
+
+    /// @brief Make a reference to an object in the arena, which stops resolving once the arena is cleaned up.
+    /// @remark Only objects in the first 4 GiB of the arena can be referenced. The generation wraps around after 2^32 cleanups, so a reference that old could resolve again.
+    /// @tparam T The type of the object.
+    /// @param object A pointer to an object allocated from the arena, or NULL.
+    /// @returns the reference, which resolves to NULL if the object is NULL or too far from the start of the arena.
+    template <typename T> inline struct ArenaRef<T> makeRef(T* object);
+
+    /// @brief Get the object a reference points to, unless the arena was cleaned up since the reference was made.
+    /// @tparam T The type of the object.
+    /// @param ref The reference, made from this arena.
+    /// @returns a pointer to the object, or NULL if the reference is stale or points to NULL.
+    template <typename T> inline T* resolve(struct ArenaRef<T> ref);
+
+    /// @brief Take ownership of another arena, so that cleaning up this arena also cleans up the other one. Nothing is copied.
+    /// @remark This is useful for gathering the arenas of parallel workers into one arena which is then cleaned up once.
+    /// @param other A pointer to the arena that will be owned.
+    /// @param freeMemory A function that will be called with the other arena's memory after it has been cleaned up (e.g. free), or NULL if the memory is not owned.
+    /// @returns a pointer to the cleanup action that was scheduled on success, or NULL if there is not enough space in this arena.
+    inline struct _PiggyBankArenaCleanupAction* adopt(struct PiggyBankArena* other, void (*freeMemory)(void*) = nullptr) {
+        struct _PiggyBankArenaCleanupAction* freeAction = nullptr;
+        if (freeMemory != nullptr) {
+            freeAction = this->scheduleCleanup(freeMemory, other);
+            if (freeAction == nullptr) {
+                return nullptr;
+            }
+        }
+
+        struct _PiggyBankArenaCleanupAction* result = this->scheduleCleanup(&PiggyBankArena::_cleanupArena, other);
+        if (result == nullptr && freeAction != nullptr) {
+            this->cancelCleanup(freeAction);
+        }
+
+        return result;
+    }
+
+    /// @brief Create a child arena inside memory allocated from this arena. The child is cleaned up along with this arena.
+    /// @remark The child can be cleaned up and reused on its own any number of times during this arena's lifetime.
+    /// @param size The size of the child arena's memory in bytes.
+    /// @returns a pointer to the initialized child arena, or NULL if there is not enough space in this arena or the size is too small for an arena.
+    inline struct PiggyBankArena* makeChild(unsigned long size) {
+        void* memory = this->alloc(size);
+        if (memory == nullptr) {
+            return nullptr;
+        }
+
+        struct PiggyBankArena* child = PiggyBankArena::init(memory, size);
+        if (child == nullptr || !this->adopt(child)) {
+            this->heapTop -= size;
+            return nullptr;
+        }
+
+        return child;
+    }
+
+    /// @brief Split all of the remaining space in this arena into equally sized child arenas, e.g. to hand them off to worker threads.
+    /// @remark The children's cleanup is scheduled on this arena right away, so joining the workers needs no further calls. The children can be used concurrently with each other, but this arena must not be cleaned up while they are still in use.
+    /// @remark The children's headers are aligned like this arena's, so a few bytes of the remaining space may be left unused.
+    /// @param count The number of child arenas to create.
+    /// @param children An array which receives the pointers to the child arenas. It must have room for at least count elements.
+    /// @returns the number of child arenas created (either count or 0 if there is not enough space in this arena for that many).
+    inline unsigned long split(unsigned long count, struct PiggyBankArena** children) {
+        if (count == 0) {
+            return 0;
+        }
+
+        const unsigned long alignment = alignof(struct PiggyBankArena);
+        unsigned long padding = (alignment - (unsigned long) (this->heapTop - (unsigned char*) this) % alignment) % alignment;
+        if (this->remainingSpace() < padding) {
+            return 0;
+        }
+
+        unsigned long childSize = (this->remainingSpace() - padding) / count;
+        if (childSize <= sizeof (struct _PiggyBankArenaCleanupAction)) {
+            return 0;
+        }
+
+        childSize = (childSize - sizeof (struct _PiggyBankArenaCleanupAction)) / alignment * alignment;
+        if (childSize <= sizeof (struct PiggyBankArena)) {
+            return 0;
+        }
+
+        if (this->cleanupBlocks != nullptr && PiggyBankArena::_cleanupBlockSpace(this->cleanupBlocks) / sizeof (struct _PiggyBankArenaCleanupAction) < count) {
+            return 0;
+        }
+
+        this->alloc(padding);
+        for (unsigned long i = 0; i < count; i++) {
+            children[i] = this->makeChild(childSize);
+        }
+
+        return count;
+    }
+
+    /// @brief Get the cleanup action after the given one in the cleanup action stack, skipping over inline payloads.
+    static inline struct _PiggyBankArenaCleanupAction* _nextCleanupAction(struct _PiggyBankArenaCleanupAction* action) {
+        return action->func != nullptr ? action + 1 : action + 1 + ((uintptr_t) action->argument >> 1);
+    }
+
+    /// @brief Run the cleanup actions in a cleanup action stack, from the given bottom up to its end.
+    static inline void _runCleanupActions(struct _PiggyBankArenaCleanupAction* action, void* end) {
+        while (action < end) {
+            if (action->func != nullptr) {
+                action->func(action->argument);
+                action++;
+            } else {
+                action += 1 + ((uintptr_t) action->argument >> 1);
+            }
+        }
+    }
+
+    /// @brief Run the phased cleanup actions in ascending phase order, and empty the phase lists.
+    inline void _runCleanupPhases() {
+        for (unsigned int phase = 0; phase < PIGGYBANKARENA_CLEANUP_PHASES; phase++) {
+            struct _PiggyBankArenaCleanupAction* phaseAction = this->cleanupPhases[phase];
+            while (phaseAction != nullptr) {
+                if (phaseAction->func != nullptr) {
+                    phaseAction->func(phaseAction->argument);
+                }
+                phaseAction = (struct _PiggyBankArenaCleanupAction*) phaseAction[1].argument;
+            }
+            this->cleanupPhases[phase] = nullptr;
+        }
+    }
+
+    /// @brief The cleanup function of independent cleanup actions, which calls the cleanup action stored in their payload.
+    static inline void _runIndependentCleanup(void* action) {
+        ((struct _PiggyBankArenaCleanupAction*) action)->func(((struct _PiggyBankArenaCleanupAction*) action)->argument);
     }
 
 private:
+    static inline unsigned long _cleanupBlockSpace(struct _PiggyBankArenaCleanupBlock* block) {
+        return ((unsigned char*) block->cleanupActionsBottom) - (unsigned char*) (block + 1);
+    }
+
+    inline struct _PiggyBankArenaCleanupAction*& _cleanupStackBottom() {
+        return this->cleanupBlocks ? this->cleanupBlocks->cleanupActionsBottom : this->cleanupActionsBottom;
+    }
+
+    inline void* _cleanupStackEnd() {
+        return this->cleanupBlocks ? this->cleanupBlocks->end : this->end;
+    }
+
+    inline struct _PiggyBankArenaCleanupAction* _pushCleanupActions(unsigned long count) {
+        struct _PiggyBankArenaCleanupBlock* block = this->cleanupBlocks;
+        if (block != nullptr) {
+            if (PiggyBankArena::_cleanupBlockSpace(block) / sizeof (struct _PiggyBankArenaCleanupAction) < count) {
+                return nullptr;
+            }
+
+            block->cleanupActionsBottom -= count;
+            return block->cleanupActionsBottom;
+        }
+
+        if (this->remainingSpace() / sizeof (struct _PiggyBankArenaCleanupAction) < count) {
+            return nullptr;
+        }
+
+        this->cleanupActionsBottom -= count;
+        return this->cleanupActionsBottom;
+    }
+
+    inline struct _PiggyBankArenaCleanupAction* _pushPayloadCleanupAction(void (*cleanupFunction)(void*), unsigned long payloadSize) {
+        unsigned long payloadCount = (payloadSize + sizeof (struct _PiggyBankArenaCleanupAction) - 1) / sizeof (struct _PiggyBankArenaCleanupAction);
+        struct _PiggyBankArenaCleanupAction* action = this->_pushCleanupActions(2 + payloadCount);
+        if (action == nullptr) {
+            return nullptr;
+        }
+
+        action[1].func = nullptr;
+        action[1].argument = (void*) (uintptr_t) (payloadCount << 1);
+        action->func = cleanupFunction;
+        action->argument = action + 2;
+        return action;
+    }
+
+    template <typename F> static inline void _runDeferred(void* function) {
+        (*(F*)function)();
+        ((F*)function)->~F();
+    }
+
+    static inline void _cleanupArena(void* arena) {
+        ((struct PiggyBankArena*) arena)->cleanup();
+    }
+
+    // The count comes first, so the pointer to it returned by scheduleDestroyObjects also points to the run
+    struct _ObjectRun {
+        unsigned long count;
+        void *first;
+    };
+
+    struct _ObjectGroup {
+        void *first;
+        void *end;
+    };
+
+    template <typename T> static inline void _destroyObjectGroup(void* group) {
+        T* first = (T*) ((struct _ObjectGroup*) group)->first;
+        for (T* object = (T*) ((struct _ObjectGroup*) group)->end; object != first; object--) {
+            object[-1].~T();
+        }
+    }
+
+    template <typename T> static inline void _destroyObjectRun(void* run) {
+        T* first = (T*) ((struct _ObjectRun*) run)->first;
+        for (unsigned long i = ((struct _ObjectRun*) run)->count; i > 0; i--) {
+            first[i - 1].~T();
+        }
+    }
+
     template <typename T> static inline void _destroyObject(void* obj) {
         if (obj != nullptr) {
             ((T*)obj)->~T();
@@ -117,4 +613,62 @@ private:
     }
 };
 
+/// @brief A cursor over memory reserved from an arena upfront. Allocating through it does no bounds checks.
+struct PiggyBankArenaCursor {
+    struct PiggyBankArena *arena;
+    unsigned char *top;
+    unsigned char *end;
+
+    /// @brief Allocate memory through the cursor.
+    /// @remark There are no bounds checks - the caller must not allocate more than the size the cursor was reserved with.
+    /// @param size The amount of memory in bytes.
+    /// @returns a pointer to the allocated memory.
+    inline void* alloc(unsigned long size) {
+        void* result = this->top;
+        this->top += size;
+        return result;
+    }
+
+    /// @brief Release the cursor, giving its unused memory back to the arena.
+    /// @remark The unused memory can only be given back if nothing else was allocated from the arena after the cursor was reserved. Otherwise it stays allocated until the arena is cleaned up.
+    inline void release() {
+        if (this->arena->heapTop == this->end) {
+            this->arena->heapTop = this->top;
+        }
+
+        this->end = this->top;
+    }
+};
+
+/// @brief A reference to an object in an arena, which can tell whether the arena was cleaned up since it was made. It is half the size of a pointer and a generation.
+/// @tparam T The type of the object.
+template <typename T> struct ArenaRef {
+    unsigned int offset;
+    unsigned int generation;
+};
+
+template <typename T> inline struct ArenaRef<T> PiggyBankArena::makeRef(T* object) {
+    unsigned long long offset = object ? (unsigned long long) ((unsigned char*) object - (unsigned char*) this) : 0;
+    struct ArenaRef<T> result;
+    result.offset = offset == (unsigned int) offset ? (unsigned int) offset : 0;
+    result.generation = this->generation;
+    return result;
 }
+
+template <typename T> inline T* PiggyBankArena::resolve(struct ArenaRef<T> ref) {
+    if (ref.generation != this->generation || ref.offset == 0) {
+        return nullptr;
+    }
+
+    return (T*) ((unsigned char*) this + ref.offset);
+}
+
+inline struct PiggyBankArenaCursor PiggyBankArena::reserveCursor(unsigned long size) {
+    struct PiggyBankArenaCursor result;
+    result.arena = this;
+    result.top = (unsigned char*) this->alloc(size);
+    result.end = result.top ? result.top + size : (unsigned char*) nullptr;
+    return result;
+}
+
+}
\ No newline at end of file
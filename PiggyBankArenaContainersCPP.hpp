@@ -0,0 +1,1227 @@
+/// PiggyBankArena: Allocate memory into a block which you free all at once.
+/// Containers for the C++ version of the library.
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <functional>
+#include <streambuf>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "PiggyBankArenaCPP.hpp"
+
+namespace PiggyBankArena {
+
+/// @brief A growable array which allocates its elements from an arena.
+/// @remark While its buffer is the most recent allocation of the arena, the vector grows in place without copying. Otherwise it moves its elements into a new buffer twice as large, leaving the old one to the arena. Memory is never given back - the arena does that when it is cleaned up, along with calling the destructors of the remaining elements.
+/// @tparam T The type of the elements.
+template <typename T> class ArenaVector {
+public:
+    /// @brief Create an empty vector. Nothing is allocated until the first element is added.
+    /// @param arena A pointer to the arena which the elements are allocated from. It must outlive the vector.
+    inline ArenaVector(struct PiggyBankArena* arena) : _arena(arena), _data(nullptr), _size(0), _capacity(0), _destroyCount(nullptr) {}
+
+    ArenaVector(const ArenaVector&) = delete;
+    ArenaVector& operator=(const ArenaVector&) = delete;
+
+    /// @brief Make sure the vector has room for at least the given number of elements.
+    /// @param capacity The number of elements.
+    /// @returns true on success, false if there is insufficient space in the arena.
+    inline bool reserve(unsigned long capacity) {
+        return capacity <= this->_capacity || this->_grow(capacity, capacity);
+    }
+
+    /// @brief Construct a new element at the end of the vector.
+    /// @param args The arguments passed to the element's constructor.
+    /// @returns a pointer to the new element, or NULL if there is insufficient space in the arena.
+    template <typename... Args> inline T* emplaceBack(Args&&... args) {
+        unsigned long capacity = this->_capacity ? this->_capacity * 2 : 4;
+        if (this->_size == this->_capacity && !this->_growInPlace(capacity, this->_size + 1)) {
+            // The arguments may refer to the old elements (e.g. pushBack(vector[0])), so the new element is built before they are moved
+            unsigned long* destroyCount;
+            T* data = this->_allocateBuffer(capacity, this->_size + 1, destroyCount);
+            if (data == nullptr) {
+                return nullptr;
+            }
+
+            T* result = new (data + this->_size) T(std::forward<Args>(args)...);
+            this->_moveTo(data, capacity, destroyCount);
+            this->_size++;
+            if (this->_destroyCount != nullptr) {
+                *this->_destroyCount = this->_size;
+            }
+
+            return result;
+        }
+
+        T* result = new (this->_data + this->_size) T(std::forward<Args>(args)...);
+        this->_size++;
+        if (this->_destroyCount != nullptr) {
+            *this->_destroyCount = this->_size;
+        }
+
+        return result;
+    }
+
+    /// @brief Copy an element to the end of the vector.
+    /// @param value The element to copy.
+    /// @returns true on success, false if there is insufficient space in the arena.
+    inline bool pushBack(const T& value) {
+        return this->emplaceBack(value) != nullptr;
+    }
+
+    /// @brief Destroy the last element of the vector. Its memory stays allocated for the next element.
+    inline void popBack() {
+        this->_size--;
+        if (this->_destroyCount != nullptr) {
+            *this->_destroyCount = this->_size;
+        }
+
+        this->_data[this->_size].~T();
+    }
+
+    /// @brief Destroy all elements of the vector. Their memory stays allocated for new elements.
+    inline void clear() {
+        while (this->_size != 0) {
+            this->popBack();
+        }
+    }
+
+    /// @brief Get the element at the given index. There are no bounds checks.
+    inline T& operator[](unsigned long index) {
+        return this->_data[index];
+    }
+
+    /// @brief Get the element at the given index. There are no bounds checks.
+    inline const T& operator[](unsigned long index) const {
+        return this->_data[index];
+    }
+
+    /// @brief Get a pointer to the first element.
+    inline T* data() {
+        return this->_data;
+    }
+
+    /// @brief Get the number of elements.
+    inline unsigned long size() const {
+        return this->_size;
+    }
+
+    /// @brief Get the number of elements the vector has room for before it has to grow.
+    inline unsigned long capacity() const {
+        return this->_capacity;
+    }
+
+    /// @brief Get a pointer to the first element.
+    inline T* begin() {
+        return this->_data;
+    }
+
+    /// @brief Get a pointer past the last element.
+    inline T* end() {
+        return this->_data + this->_size;
+    }
+
+private:
+    inline bool _grow(unsigned long capacity, unsigned long minCapacity) {
+        if (this->_growInPlace(capacity, minCapacity)) {
+            return true;
+        }
+
+        unsigned long* destroyCount;
+        T* data = this->_allocateBuffer(capacity, minCapacity, destroyCount);
+        if (data == nullptr) {
+            return false;
+        }
+
+        this->_moveTo(data, capacity, destroyCount);
+        return true;
+    }
+
+    inline bool _growInPlace(unsigned long capacity, unsigned long minCapacity) {
+        if (this->_data == nullptr || (unsigned char*) (this->_data + this->_capacity) != this->_arena->heapTop) {
+            return false;
+        }
+
+        if (capacity < minCapacity) {
+            capacity = minCapacity;
+        }
+
+        if (capacity - this->_capacity <= this->_arena->remainingSpace() / sizeof(T)) {
+            this->_arena->alloc((capacity - this->_capacity) * sizeof(T));
+            this->_capacity = capacity;
+            return true;
+        }
+
+        if (minCapacity - this->_capacity <= this->_arena->remainingSpace() / sizeof(T)) {
+            this->_arena->alloc((minCapacity - this->_capacity) * sizeof(T));
+            this->_capacity = minCapacity;
+            return true;
+        }
+
+        return false;
+    }
+
+    // Allocates a new buffer, along with the cleanup action for its elements if the vector has none yet. The capacity is lowered to the minimum if there is not enough space for it.
+    inline T* _allocateBuffer(unsigned long& capacity, unsigned long minCapacity, unsigned long*& destroyCount) {
+        if (capacity < minCapacity || capacity > this->_arena->remainingSpace() / sizeof(T)) {
+            capacity = minCapacity;
+        }
+
+        T* data = this->_arena->allocArray<T>(capacity, false);
+        if (data == nullptr) {
+            return nullptr;
+        }
+
+        // The cleanup action of the old buffer is reused for the new one
+        destroyCount = this->_destroyCount;
+        if (!std::is_trivially_destructible<T>::value && destroyCount == nullptr) {
+            destroyCount = this->_arena->scheduleDestroyObjects<T>(data, 0);
+            if (destroyCount == nullptr) {
+                this->_arena->heapTop -= capacity * sizeof(T);
+                return nullptr;
+            }
+        }
+
+        return data;
+    }
+
+    inline void _moveTo(T* data, unsigned long capacity, unsigned long* destroyCount) {
+        for (unsigned long i = 0; i < this->_size; i++) {
+            new (data + i) T(std::move(this->_data[i]));
+            this->_data[i].~T();
+        }
+
+        if (destroyCount != nullptr) {
+            this->_arena->moveDestroyObjects<T>(destroyCount, data);
+            *destroyCount = this->_size;
+        }
+
+        this->_data = data;
+        this->_capacity = capacity;
+        this->_destroyCount = destroyCount;
+    }
+
+    struct PiggyBankArena* _arena;
+    T* _data;
+    unsigned long _size;
+    unsigned long _capacity;
+    unsigned long* _destroyCount;
+};
+
+/// @brief A growable array which allocates its elements from an arena in fixed-size chunks.
+/// @remark Elements never move once they are added, so pointers to them stay valid until the arena is cleaned up. Growing never copies elements, only the index of chunk pointers. The destructors of the elements are called when the arena is cleaned up.
+/// @tparam T The type of the elements.
+/// @tparam ChunkSize The number of elements in each chunk.
+template <typename T, unsigned long ChunkSize = 64> class ArenaSegmentedVector {
+public:
+    /// @brief Create an empty vector. Nothing is allocated until the first element is added.
+    /// @param arena A pointer to the arena which the elements are allocated from. It must outlive the vector.
+    inline ArenaSegmentedVector(struct PiggyBankArena* arena) : _arena(arena), _chunks(arena), _size(0), _destroyCount(nullptr) {}
+
+    ArenaSegmentedVector(const ArenaSegmentedVector&) = delete;
+    ArenaSegmentedVector& operator=(const ArenaSegmentedVector&) = delete;
+
+    /// @brief Construct a new element at the end of the vector.
+    /// @param args The arguments passed to the element's constructor.
+    /// @returns a pointer to the new element, or NULL if there is insufficient space in the arena.
+    template <typename... Args> inline T* emplaceBack(Args&&... args) {
+        if (this->_size == this->_chunks.size() * ChunkSize && !this->_addChunk()) {
+            return nullptr;
+        }
+
+        T* result = new (this->_chunks[this->_size / ChunkSize] + this->_size % ChunkSize) T(std::forward<Args>(args)...);
+        this->_size++;
+        if (this->_destroyCount != nullptr) {
+            (*this->_destroyCount)++;
+        }
+
+        return result;
+    }
+
+    /// @brief Copy an element to the end of the vector.
+    /// @param value The element to copy.
+    /// @returns true on success, false if there is insufficient space in the arena.
+    inline bool pushBack(const T& value) {
+        return this->emplaceBack(value) != nullptr;
+    }
+
+    /// @brief Get the element at the given index. There are no bounds checks.
+    inline T& operator[](unsigned long index) {
+        return this->_chunks[index / ChunkSize][index % ChunkSize];
+    }
+
+    /// @brief Get the element at the given index. There are no bounds checks.
+    inline const T& operator[](unsigned long index) const {
+        return this->_chunks[index / ChunkSize][index % ChunkSize];
+    }
+
+    /// @brief Get the number of elements.
+    inline unsigned long size() const {
+        return this->_size;
+    }
+
+    /// @brief Get the number of chunks allocated so far.
+    inline unsigned long chunkCount() const {
+        return this->_chunks.size();
+    }
+
+private:
+    inline bool _addChunk() {
+        // Make room in the index first, so that a new chunk is never left without an entry
+        if (!this->_chunks.pushBack(nullptr)) {
+            return false;
+        }
+
+        T* chunk = this->_arena->allocArray<T>(ChunkSize, false);
+        if (chunk == nullptr) {
+            this->_chunks.popBack();
+            return false;
+        }
+
+        if (!std::is_trivially_destructible<T>::value) {
+            this->_destroyCount = this->_arena->scheduleDestroyObjects<T>(chunk, 0);
+            if (this->_destroyCount == nullptr) {
+                this->_arena->heapTop -= ChunkSize * sizeof(T);
+                this->_chunks.popBack();
+                return false;
+            }
+        }
+
+        this->_chunks[this->_chunks.size() - 1] = chunk;
+        return true;
+    }
+
+    struct PiggyBankArena* _arena;
+    ArenaVector<T*> _chunks;
+    unsigned long _size;
+    unsigned long* _destroyCount;
+};
+
+/// @brief Get a bit mask of the bytes in a group of 16 control bytes which are equal to the given value.
+inline unsigned int _matchControlBytes(const unsigned char* group, unsigned char value) {
+#ifdef __SSE2__
+    return (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) group), _mm_set1_epi8((char) value)));
+#else
+    unsigned int result = 0;
+    for (unsigned int i = 0; i < 16; i++) {
+        result |= (unsigned int) (group[i] == value) << i;
+    }
+    return result;
+#endif
+}
+
+/// @brief Get a bit mask of the bytes in a group of 16 control bytes which mark free (empty or deleted) slots.
+inline unsigned int _matchFreeControlBytes(const unsigned char* group) {
+#ifdef __SSE2__
+    return (unsigned int) _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) group));
+#else
+    unsigned int result = 0;
+    for (unsigned int i = 0; i < 16; i++) {
+        result |= (unsigned int) (group[i] >> 7) << i;
+    }
+    return result;
+#endif
+}
+
+inline unsigned int _lowestBitIndex(unsigned int mask) {
+#ifdef __GNUC__
+    return (unsigned int) __builtin_ctz(mask);
+#else
+    unsigned int result = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        result++;
+    }
+    return result;
+#endif
+}
+
+/// @brief A hash map with open addressing which allocates all of its memory from an arena.
+/// @remark The slots are probed in groups of 16 using one control byte per slot, which holds 7 bits of the key's hash (or marks the slot as empty or deleted). With SSE2, a whole group is compared at once. When the map grows, its entries move into a new table and the old one is left to the arena.
+/// @remark The destructors of the remaining entries are called when the arena is cleaned up.
+/// @tparam K The type of the keys.
+/// @tparam V The type of the values.
+/// @tparam Hash The hash function object type.
+/// @tparam Equal The key equality function object type.
+template <typename K, typename V, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>> class ArenaHashMap {
+public:
+    /// @brief Create an empty map. Nothing is allocated until the first entry is added.
+    /// @param arena A pointer to the arena which the map is allocated from. It must outlive the map.
+    inline ArenaHashMap(struct PiggyBankArena* arena) : _arena(arena), _table(nullptr), _size(0), _growthLeft(0), _cleanupAction(nullptr) {}
+
+    ArenaHashMap(const ArenaHashMap&) = delete;
+    ArenaHashMap& operator=(const ArenaHashMap&) = delete;
+
+    /// @brief Find the value for the given key.
+    /// @param key The key to look for.
+    /// @returns a pointer to the value, or NULL if the key is not in the map.
+    inline V* find(const K& key) {
+        unsigned long index = this->_findIndex(key);
+        return index != ~0UL ? &this->_table->entries[index].value : nullptr;
+    }
+
+    /// @brief Add an entry to the map, constructing its value in place, unless the key is already in the map.
+    /// @param key The key of the entry.
+    /// @param args The arguments passed to the value's constructor.
+    /// @returns a pointer to the value of the new entry or of the existing one with the same key, or NULL if there is insufficient space in the arena.
+    template <typename... Args> inline V* emplace(const K& key, Args&&... args) {
+        V* existing = this->find(key);
+        if (existing != nullptr) {
+            return existing;
+        }
+
+        if (this->_growthLeft == 0 && !this->_rehash()) {
+            return nullptr;
+        }
+
+        unsigned long long hash = this->_hash(key);
+        unsigned long index = this->_findFreeSlot(hash);
+        if (this->_table->control[index] == _EMPTY) {
+            this->_growthLeft--;
+        }
+
+        struct _Entry* entry = this->_table->entries + index;
+        new (&entry->key) K(key);
+        new (&entry->value) V(std::forward<Args>(args)...);
+        this->_table->control[index] = (unsigned char) (hash & 0x7F);
+        this->_size++;
+        return &entry->value;
+    }
+
+    /// @brief Add an entry to the map, unless the key is already in the map.
+    /// @param key The key of the entry.
+    /// @param value The value of the entry, which is copied.
+    /// @returns a pointer to the value of the new entry or of the existing one with the same key, or NULL if there is insufficient space in the arena.
+    inline V* insert(const K& key, const V& value) {
+        return this->emplace(key, value);
+    }
+
+    /// @brief Remove the entry with the given key from the map and destroy it.
+    /// @param key The key of the entry.
+    /// @returns true if the entry was removed, false if the key is not in the map.
+    inline bool erase(const K& key) {
+        unsigned long index = this->_findIndex(key);
+        if (index == ~0UL) {
+            return false;
+        }
+
+        struct _Entry* entry = this->_table->entries + index;
+        entry->key.~K();
+        entry->value.~V();
+        this->_size--;
+
+        // A group which still has an empty slot was never full, so no probe went past it and the slot can become empty again
+        if (_matchControlBytes(this->_table->control + (index & ~15UL), _EMPTY) != 0) {
+            this->_table->control[index] = _EMPTY;
+            this->_growthLeft++;
+        } else {
+            this->_table->control[index] = _DELETED;
+        }
+
+        return true;
+    }
+
+    /// @brief Get the number of entries.
+    inline unsigned long size() const {
+        return this->_size;
+    }
+
+    /// @brief Get the number of slots in the current table.
+    inline unsigned long capacity() const {
+        return this->_table ? this->_table->capacity : 0;
+    }
+
+private:
+    static const unsigned char _EMPTY = 0x80;
+    static const unsigned char _DELETED = 0xFE;
+
+    struct _Entry {
+        K key;
+        V value;
+    };
+
+    struct _Table {
+        unsigned char* control;
+        struct _Entry* entries;
+        unsigned long capacity;
+    };
+
+    inline unsigned long long _hash(const K& key) const {
+        unsigned long long hash = (unsigned long long) Hash()(key) * 0x9E3779B97F4A7C15ULL;
+        return hash ^ (hash >> 32);
+    }
+
+    inline unsigned long _findIndex(const K& key) {
+        if (this->_table == nullptr) {
+            return ~0UL;
+        }
+
+        unsigned long long hash = this->_hash(key);
+        unsigned long mask = this->_table->capacity - 1;
+        unsigned long position = (unsigned long) (hash >> 7) & mask & ~15UL;
+        for (unsigned long step = 16; ; step += 16) {
+            for (unsigned int matches = _matchControlBytes(this->_table->control + position, (unsigned char) (hash & 0x7F)); matches != 0; matches &= matches - 1) {
+                unsigned long index = position + _lowestBitIndex(matches);
+                if (Equal()(this->_table->entries[index].key, key)) {
+                    return index;
+                }
+            }
+
+            if (_matchControlBytes(this->_table->control + position, _EMPTY) != 0) {
+                return ~0UL;
+            }
+
+            position = (position + step) & mask;
+        }
+    }
+
+    inline unsigned long _findFreeSlot(unsigned long long hash) {
+        unsigned long mask = this->_table->capacity - 1;
+        unsigned long position = (unsigned long) (hash >> 7) & mask & ~15UL;
+        for (unsigned long step = 16; ; step += 16) {
+            unsigned int free = _matchFreeControlBytes(this->_table->control + position);
+            if (free != 0) {
+                return position + _lowestBitIndex(free);
+            }
+
+            position = (position + step) & mask;
+        }
+    }
+
+    static inline void _destroyTable(void* table) {
+        struct _Table* t = (struct _Table*) table;
+        for (unsigned long i = 0; i < t->capacity; i++) {
+            if (t->control[i] < 0x80) {
+                t->entries[i].key.~K();
+                t->entries[i].value.~V();
+            }
+        }
+    }
+
+    inline bool _rehash() {
+        unsigned long capacity = 16;
+        while (capacity / 8 * 7 < (this->_size + 1) * 2) {
+            capacity *= 2;
+        }
+
+        unsigned char* heapTop = this->_arena->heapTop;
+        struct _Entry* entries = this->_arena->allocArray<struct _Entry>(capacity, false);
+        unsigned char* control = (unsigned char*) this->_arena->alloc(capacity);
+        struct _Table* table = this->_arena->allocArray<struct _Table>(1, false);
+        if (entries == nullptr || control == nullptr || table == nullptr) {
+            this->_arena->heapTop = heapTop;
+            return false;
+        }
+
+        table->control = control;
+        table->entries = entries;
+        table->capacity = capacity;
+        for (unsigned long i = 0; i < capacity; i++) {
+            control[i] = _EMPTY;
+        }
+
+        struct _PiggyBankArenaCleanupAction* cleanupAction = nullptr;
+        if (!std::is_trivially_destructible<struct _Entry>::value) {
+            cleanupAction = this->_arena->scheduleCleanup(&ArenaHashMap::_destroyTable, table);
+            if (cleanupAction == nullptr) {
+                this->_arena->heapTop = heapTop;
+                return false;
+            }
+        }
+
+        struct _Table* oldTable = this->_table;
+        this->_table = table;
+        this->_growthLeft = capacity / 8 * 7 - this->_size;
+        if (oldTable != nullptr) {
+            for (unsigned long i = 0; i < oldTable->capacity; i++) {
+                if (oldTable->control[i] < 0x80) {
+                    struct _Entry* entry = oldTable->entries + i;
+                    unsigned long long hash = this->_hash(entry->key);
+                    unsigned long index = this->_findFreeSlot(hash);
+                    new (&entries[index].key) K(std::move(entry->key));
+                    new (&entries[index].value) V(std::move(entry->value));
+                    control[index] = (unsigned char) (hash & 0x7F);
+                    entry->key.~K();
+                    entry->value.~V();
+                }
+            }
+
+            if (this->_cleanupAction != nullptr) {
+                this->_arena->cancelCleanup(this->_cleanupAction);
+            }
+        }
+
+        this->_cleanupAction = cleanupAction;
+        return true;
+    }
+
+    struct PiggyBankArena* _arena;
+    struct _Table* _table;
+    unsigned long _size;
+    unsigned long _growthLeft;
+    struct _PiggyBankArenaCleanupAction* _cleanupAction;
+};
+
+inline void _multiply128(unsigned long long* a, unsigned long long* b) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 result = (unsigned __int128) *a * *b;
+    *a = (unsigned long long) result;
+    *b = (unsigned long long) (result >> 64);
+#else
+    unsigned long long highA = *a >> 32, highB = *b >> 32, lowA = (unsigned int) *a, lowB = (unsigned int) *b;
+    unsigned long long high = highA * highB, middle0 = highA * lowB, middle1 = highB * lowA, low = lowA * lowB;
+    unsigned long long t = low + (middle0 << 32);
+    unsigned long long carry = t < low;
+    low = t + (middle1 << 32);
+    carry += low < t;
+    *a = low;
+    *b = high + (middle0 >> 32) + (middle1 >> 32) + carry;
+#endif
+}
+
+inline unsigned long long _mix64(unsigned long long a, unsigned long long b) {
+    _multiply128(&a, &b);
+    return a ^ b;
+}
+
+inline unsigned long long _read64(const unsigned char* p) {
+    unsigned long long result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+inline unsigned long long _read32(const unsigned char* p) {
+    unsigned int result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+/// @brief Hash a block of memory with a fast 64-bit hash function (following wyhash).
+/// @remark The result depends on the byte order of the machine, so it should not be stored or sent elsewhere.
+/// @param data A pointer to the memory.
+/// @param length The length of the memory in bytes.
+/// @param seed A seed which changes the result.
+/// @returns the hash.
+inline unsigned long long hashBytes(const void* data, unsigned long length, unsigned long long seed = 0) {
+    const unsigned long long secret0 = 0xa0761d6478bd642fULL, secret1 = 0xe7037ed1a0b428dbULL, secret2 = 0x8ebc6af09c88c6e3ULL, secret3 = 0x589965cc75374cc3ULL;
+    const unsigned char* p = (const unsigned char*) data;
+    unsigned long long a, b;
+    seed ^= _mix64(seed ^ secret0, secret1);
+    if (length <= 16) {
+        if (length >= 4) {
+            a = (_read32(p) << 32) | _read32(p + ((length >> 3) << 2));
+            b = (_read32(p + length - 4) << 32) | _read32(p + length - 4 - ((length >> 3) << 2));
+        } else if (length > 0) {
+            a = ((unsigned long long) p[0] << 16) | ((unsigned long long) p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        unsigned long remaining = length;
+        if (remaining > 48) {
+            unsigned long long seed1 = seed, seed2 = seed;
+            do {
+                seed = _mix64(_read64(p) ^ secret1, _read64(p + 8) ^ seed);
+                seed1 = _mix64(_read64(p + 16) ^ secret2, _read64(p + 24) ^ seed1);
+                seed2 = _mix64(_read64(p + 32) ^ secret3, _read64(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (remaining > 16) {
+            seed = _mix64(_read64(p) ^ secret1, _read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+
+        a = _read64(p + remaining - 16);
+        b = _read64(p + remaining - 8);
+    }
+
+    a ^= secret1;
+    b ^= seed;
+    _multiply128(&a, &b);
+    return _mix64(a ^ secret0 ^ length, b ^ secret1);
+}
+
+/// @brief A hash function object for strings, using hashBytes.
+struct ArenaStringHash {
+    inline unsigned long long operator()(std::string_view string) const {
+        return hashBytes(string.data(), string.size());
+    }
+};
+
+/// @brief A set of unique strings whose characters are stored in an arena.
+/// @remark Each distinct string is stored once, followed by a terminating zero. Interning the same characters again returns the same view, so interned strings can be compared by their data pointers.
+class ArenaStringInterner {
+public:
+    /// @brief Create an empty interner. Nothing is allocated until the first string is interned.
+    /// @param arena A pointer to the arena which the strings are allocated from. It must outlive the interner.
+    inline ArenaStringInterner(struct PiggyBankArena* arena) : _arena(arena), _strings(arena) {}
+
+    ArenaStringInterner(const ArenaStringInterner&) = delete;
+    ArenaStringInterner& operator=(const ArenaStringInterner&) = delete;
+
+    /// @brief Get the interned copy of a string, storing it first if it was not interned yet.
+    /// @param string The characters of the string.
+    /// @returns a view of the interned string, or a view with a NULL data pointer if there is insufficient space in the arena.
+    inline std::string_view intern(std::string_view string) {
+        std::string_view* existing = this->_strings.find(string);
+        if (existing != nullptr) {
+            return *existing;
+        }
+
+        unsigned char* heapTop = this->_arena->heapTop;
+        char* characters = (char*) this->_arena->alloc(string.size() + 1);
+        if (characters == nullptr) {
+            return std::string_view();
+        }
+
+        memcpy(characters, string.data(), string.size());
+        characters[string.size()] = 0;
+
+        std::string_view result(characters, string.size());
+        if (this->_strings.insert(result, result) == nullptr) {
+            this->_arena->heapTop = heapTop;
+            return std::string_view();
+        }
+
+        return result;
+    }
+
+    /// @brief Get the interned copy of a string without storing it.
+    /// @param string The characters of the string.
+    /// @returns a view of the interned string, or a view with a NULL data pointer if the string was not interned.
+    inline std::string_view find(std::string_view string) {
+        std::string_view* existing = this->_strings.find(string);
+        return existing != nullptr ? *existing : std::string_view();
+    }
+
+    /// @brief Get the number of distinct strings.
+    inline unsigned long size() const {
+        return this->_strings.size();
+    }
+
+private:
+    struct PiggyBankArena* _arena;
+    ArenaHashMap<std::string_view, std::string_view, ArenaStringHash> _strings;
+};
+
+/// @brief Builds a string directly at the top of an arena's heap.
+/// @remark While the string is the most recent allocation of the arena, it grows in place without copying. Otherwise its characters are copied to a new buffer twice as large. Finishing the string gives its unused capacity back to the arena, if nothing was allocated after it.
+class ArenaStringBuilder {
+public:
+    /// @brief Create a builder for an empty string. Nothing is allocated until the first characters are appended.
+    /// @param arena A pointer to the arena which the string is allocated from. It must outlive the builder.
+    inline ArenaStringBuilder(struct PiggyBankArena* arena) : _arena(arena), _data(nullptr), _size(0), _capacity(0) {}
+
+    ArenaStringBuilder(const ArenaStringBuilder&) = delete;
+    ArenaStringBuilder& operator=(const ArenaStringBuilder&) = delete;
+
+    /// @brief Append characters to the string.
+    /// @param string The characters to append.
+    /// @returns true on success, false if there is insufficient space in the arena (in which case nothing is appended).
+    inline bool append(std::string_view string) {
+        if (!this->_reserve(string.size())) {
+            return false;
+        }
+
+        memcpy(this->_data + this->_size, string.data(), string.size());
+        this->_size += string.size();
+        return true;
+    }
+
+    /// @brief Append a single character to the string.
+    /// @param character The character to append.
+    /// @returns true on success, false if there is insufficient space in the arena.
+    inline bool appendChar(char character) {
+        if (!this->_reserve(1)) {
+            return false;
+        }
+
+        this->_data[this->_size++] = character;
+        return true;
+    }
+
+    /// @brief Append the decimal representation of an unsigned integer to the string.
+    /// @param value The integer.
+    /// @returns true on success, false if there is insufficient space in the arena (in which case nothing is appended).
+    inline bool appendUnsigned(unsigned long long value) {
+        char digits[20];
+        unsigned int count = 0;
+        do {
+            digits[sizeof(digits) - ++count] = (char) ('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+
+        return this->append(std::string_view(digits + sizeof(digits) - count, count));
+    }
+
+    /// @brief Append the decimal representation of a signed integer to the string.
+    /// @param value The integer.
+    /// @returns true on success, false if there is insufficient space in the arena (in which case nothing is appended).
+    inline bool appendInteger(long long value) {
+        if (value >= 0) {
+            return this->appendUnsigned((unsigned long long) value);
+        }
+
+        unsigned long size = this->_size;
+        if (!this->appendChar('-') || !this->appendUnsigned(0ULL - (unsigned long long) value)) {
+            this->_size = size;
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Append a floating point number to the string, formatted like printf's %g.
+    /// @param value The number.
+    /// @param precision The number of significant digits.
+    /// @returns true on success, false if there is insufficient space in the arena (in which case nothing is appended).
+    inline bool appendFloat(double value, int precision = 6) {
+        return this->appendFormat("%.*g", precision, value);
+    }
+
+    /// @brief Append printf-style formatted text to the string. It is formatted directly into the arena's memory.
+    /// @param format The format string, as for printf.
+    /// @returns true on success, false if there is insufficient space in the arena or the text cannot be formatted (in which case nothing is appended).
+    inline bool appendFormat(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(this->_data + this->_size, this->_capacity - this->_size, format, args);
+        va_end(args);
+        if (length < 0) {
+            return false;
+        }
+
+        if ((unsigned long) length >= this->_capacity - this->_size) {
+            if (!this->_reserve((unsigned long) length + 1)) {
+                return false;
+            }
+
+            va_start(args, format);
+            vsnprintf(this->_data + this->_size, (unsigned long) length + 1, format, args);
+            va_end(args);
+        }
+
+        this->_size += (unsigned long) length;
+        return true;
+    }
+
+    /// @brief Get the characters appended so far. The view is invalidated by appending more characters.
+    inline std::string_view view() const {
+        return std::string_view(this->_data, this->_size);
+    }
+
+    /// @brief Get the number of characters appended so far.
+    inline unsigned long size() const {
+        return this->_size;
+    }
+
+    /// @brief Finish the string by terminating it with a zero, and give its unused capacity back to the arena if possible.
+    /// @remark The builder is empty afterwards and can be used to build another string.
+    /// @returns a view of the string (not including the terminating zero), or a view with a NULL data pointer if there is insufficient space in the arena.
+    inline std::string_view finish() {
+        if (!this->appendChar(0)) {
+            return std::string_view();
+        }
+
+        std::string_view result(this->_data, this->_size - 1);
+        if ((unsigned char*) (this->_data + this->_capacity) == this->_arena->heapTop) {
+            this->_arena->heapTop = (unsigned char*) (this->_data + this->_size);
+        }
+
+        this->_data = nullptr;
+        this->_size = 0;
+        this->_capacity = 0;
+        return result;
+    }
+
+private:
+    inline bool _reserve(unsigned long count) {
+        if (count <= this->_capacity - this->_size) {
+            return true;
+        }
+
+        unsigned long remaining = this->_arena->remainingSpace();
+        unsigned long capacity = this->_capacity < 32 ? 64 : this->_capacity * 2;
+        if (capacity < this->_size + count) {
+            capacity = this->_size + count;
+        }
+
+        if (this->_data != nullptr && (unsigned char*) (this->_data + this->_capacity) == this->_arena->heapTop) {
+            if (this->_size + count - this->_capacity > remaining) {
+                return false;
+            }
+
+            unsigned long growth = capacity - this->_capacity < remaining ? capacity - this->_capacity : remaining;
+            this->_arena->alloc(growth);
+            this->_capacity += growth;
+            return true;
+        }
+
+        if (this->_size + count > remaining) {
+            return false;
+        }
+
+        if (capacity > remaining) {
+            capacity = remaining;
+        }
+
+        char* data = (char*) this->_arena->alloc(capacity);
+        if (this->_size != 0) {
+            memcpy(data, this->_data, this->_size);
+        }
+
+        this->_data = data;
+        this->_capacity = capacity;
+        return true;
+    }
+
+    struct PiggyBankArena* _arena;
+    char* _data;
+    unsigned long _size;
+    unsigned long _capacity;
+};
+
+/// @brief A stream buffer which writes into an ArenaStringBuilder, so that iostreams can format into arena memory.
+/// @remark Writing fails (setting the stream's badbit) once there is insufficient space in the arena.
+class ArenaStringStreamBuffer : public std::streambuf {
+public:
+    /// @param builder A pointer to the builder which receives the characters. It must outlive the stream buffer.
+    inline ArenaStringStreamBuffer(ArenaStringBuilder* builder) : _builder(builder) {}
+
+protected:
+    inline int_type overflow(int_type character) override {
+        if (traits_type::eq_int_type(character, traits_type::eof())) {
+            return traits_type::not_eof(character);
+        }
+
+        return this->_builder->appendChar(traits_type::to_char_type(character)) ? character : traits_type::eof();
+    }
+
+    inline std::streamsize xsputn(const char* characters, std::streamsize count) override {
+        return this->_builder->append(std::string_view(characters, (unsigned long) count)) ? count : 0;
+    }
+
+private:
+    ArenaStringBuilder* _builder;
+};
+
+/// @brief A pointer which stores the distance to its target from its own address, instead of the target's address.
+/// @remark Data structures linked only through offset pointers can be copied or mapped to any address as a whole (e.g. the used part of an arena) and stay valid without any fix-up. Copying an offset pointer recomputes the distance for the new location. A zero distance means NULL, so an offset pointer cannot point to itself, and zeroed memory holds NULL offset pointers.
+/// @tparam T The type of the target.
+template <typename T> class OffsetPtr {
+public:
+    inline OffsetPtr() : _offset(0) {}
+
+    inline OffsetPtr(T* pointer) {
+        this->set(pointer);
+    }
+
+    inline OffsetPtr(const OffsetPtr& other) {
+        this->set(other.get());
+    }
+
+    inline OffsetPtr& operator=(const OffsetPtr& other) {
+        this->set(other.get());
+        return *this;
+    }
+
+    inline OffsetPtr& operator=(T* pointer) {
+        this->set(pointer);
+        return *this;
+    }
+
+    /// @brief Get the address of the target.
+    inline T* get() const {
+        // The arithmetic is done on integers, since the target is usually outside of the object this points to
+        return this->_offset != 0 ? (T*) ((uintptr_t) this + (uintptr_t) this->_offset) : nullptr;
+    }
+
+    /// @brief Point to a new target.
+    /// @param pointer A pointer to the target, or NULL.
+    inline void set(T* pointer) {
+        this->_offset = pointer != nullptr ? (long long) ((intptr_t) pointer - (intptr_t) this) : 0;
+    }
+
+    inline T& operator*() const {
+        return *this->get();
+    }
+
+    inline T* operator->() const {
+        return this->get();
+    }
+
+    inline T& operator[](unsigned long index) const {
+        return this->get()[index];
+    }
+
+    inline explicit operator bool() const {
+        return this->_offset != 0;
+    }
+
+private:
+    long long _offset;
+};
+
+/// @brief A growable array which is position-independent, so it can be copied or mapped to any address along with its elements.
+/// @remark The vector itself must be stored in the same memory as its elements (e.g. allocated from the same arena), and zeroed memory is an empty vector. Since it holds no pointer to the arena, the arena is passed to every call that may allocate. It grows in place like ArenaVector while it is the most recent allocation. The elements must be trivially destructible (no destructors are called), but may contain offset pointers.
+/// @tparam T The type of the elements.
+template <typename T> struct OffsetVector {
+    static_assert(std::is_trivially_destructible<T>::value, "OffsetVector elements must be trivially destructible");
+
+    OffsetPtr<T> items;
+    unsigned long count;
+    unsigned long capacity;
+
+    /// @brief Copy an element to the end of the vector.
+    /// @param arena A pointer to the arena which the elements are allocated from.
+    /// @param value The element to copy.
+    /// @returns true on success, false if there is insufficient space in the arena.
+    inline bool pushBack(struct PiggyBankArena* arena, const T& value) {
+        if (this->count == this->capacity && !this->_grow(arena, this->capacity ? this->capacity * 2 : 4, this->count + 1)) {
+            return false;
+        }
+
+        new (this->items.get() + this->count) T(value);
+        this->count++;
+        return true;
+    }
+
+    /// @brief Make sure the vector has room for at least the given number of elements.
+    /// @param arena A pointer to the arena which the elements are allocated from.
+    /// @param capacity The number of elements.
+    /// @returns true on success, false if there is insufficient space in the arena.
+    inline bool reserve(struct PiggyBankArena* arena, unsigned long capacity) {
+        return capacity <= this->capacity || this->_grow(arena, capacity, capacity);
+    }
+
+    /// @brief Get the element at the given index. There are no bounds checks.
+    inline T& operator[](unsigned long index) {
+        return this->items[index];
+    }
+
+    /// @brief Get a pointer to the first element.
+    inline T* begin() {
+        return this->items.get();
+    }
+
+    /// @brief Get a pointer past the last element.
+    inline T* end() {
+        return this->items.get() + this->count;
+    }
+
+    inline bool _grow(struct PiggyBankArena* arena, unsigned long capacity, unsigned long minCapacity) {
+        if (capacity < minCapacity) {
+            capacity = minCapacity;
+        }
+
+        T* items = this->items.get();
+        if (items != nullptr && (unsigned char*) (items + this->capacity) == arena->heapTop) {
+            if (capacity - this->capacity > arena->remainingSpace() / sizeof(T)) {
+                capacity = minCapacity;
+            }
+
+            if (arena->allocArray<T>(capacity - this->capacity, false) == nullptr) {
+                return false;
+            }
+
+            this->capacity = capacity;
+            return true;
+        }
+
+        if (capacity > arena->remainingSpace() / sizeof(T)) {
+            capacity = minCapacity;
+        }
+
+        T* newItems = arena->allocArray<T>(capacity, false);
+        if (newItems == nullptr) {
+            return false;
+        }
+
+        for (unsigned long i = 0; i < this->count; i++) {
+            new (newItems + i) T(items[i]);
+        }
+
+        this->items = newItems;
+        this->capacity = capacity;
+        return true;
+    }
+};
+
+/// @brief Copies objects which must outlive one arena into another, longer-lived arena, along with everything they reach in the first arena.
+/// @remark Objects are moved into the other arena, and their destructors are scheduled there. The moved-from originals are destroyed as usual when the first arena is cleaned up. Objects reachable from several places, or in cycles, are copied once. Pointers into an array promoted with promoteArray (e.g. to one of its elements) resolve to the same place in its copy, but an array must then be promoted before any pointer into it which does not point to its start.
+/// @remark Types opt in to having their pointers followed and adjusted with a trace method, which passes each pointer member through the promoter: void trace(ArenaPromoter& promoter) { this->next = promoter.promote(this->next); }. Objects of other types are copied as they are. Objects are traced from a work list, so deep structures do not cause deep recursion.
+/// @remark Bookkeeping is allocated from the first arena, which is cleaned up afterwards anyway.
+class ArenaPromoter {
+public:
+    /// @brief Create a promoter between two arenas.
+    /// @param from A pointer to the arena which objects are promoted from. Only objects allocated from it before the promoter was created are promoted.
+    /// @param to A pointer to the arena which objects are promoted to.
+    inline ArenaPromoter(struct PiggyBankArena* from, struct PiggyBankArena* to) : _from(from), _to(to), _fromTop(from->heapTop), _forwarding(from), _ranges(from), _pending(from), _tracing(false), _failed(false) {}
+
+    ArenaPromoter(const ArenaPromoter&) = delete;
+    ArenaPromoter& operator=(const ArenaPromoter&) = delete;
+
+    /// @brief Promote an object and everything it reaches.
+    /// @tparam T The type of the object.
+    /// @param object A pointer to the object. Pointers which are NULL or do not point into the first arena are returned as they are.
+    /// @returns a pointer to the promoted object, or NULL if there is insufficient space in either arena (in which case failed() returns true).
+    template <typename T> inline T* promote(T* object) {
+        return this->promoteArray<T>(object, 1);
+    }
+
+    /// @brief Promote an array of objects and everything they reach.
+    /// @tparam T The type of the objects.
+    /// @param first A pointer to the first object. Pointers which are NULL or do not point into the first arena are returned as they are.
+    /// @param count The number of objects in the array.
+    /// @returns a pointer to the first promoted object, or NULL if there is insufficient space in either arena (in which case failed() returns true).
+    template <typename T> inline T* promoteArray(T* first, unsigned long count) {
+        if (first == nullptr || (unsigned char*) first < this->_from->start || (unsigned char*) first >= this->_fromTop) {
+            return first;
+        }
+
+        void** forwarded = this->_forwarding.find(first);
+        if (forwarded != nullptr) {
+            return (T*) *forwarded;
+        }
+
+        unsigned char* interior = this->_findInterior(first);
+        if (interior != nullptr) {
+            return (T*) interior;
+        }
+
+        T* copy = nullptr;
+        if (std::is_trivially_destructible<T>::value) {
+            copy = this->_to->allocArray<T>(count, false);
+        } else if (count == 1) {
+            copy = this->_to->allocObjectGrouped<T>();
+        } else {
+            copy = this->_to->allocArray<T>(count);
+        }
+
+        if (copy == nullptr) {
+            this->_failed = true;
+            return nullptr;
+        }
+
+        for (unsigned long i = 0; i < count; i++) {
+            new (copy + i) T(std::move(first[i]));
+        }
+
+        if (this->_forwarding.insert(first, (void*) copy) == nullptr || (count > 1 && !this->_insertRange(first, count * sizeof(T), copy))) {
+            this->_failed = true;
+            return nullptr;
+        }
+
+        for (unsigned long i = 0; i < count; i++) {
+            struct _PendingTrace pending = { copy + i, &ArenaPromoter::_trace<T> };
+            if (!this->_pending.pushBack(pending)) {
+                this->_failed = true;
+                return nullptr;
+            }
+        }
+
+        if (!this->_tracing) {
+            this->_tracing = true;
+            for (unsigned long i = 0; i < this->_pending.size(); i++) {
+                struct _PendingTrace pending = this->_pending[i];
+                pending.trace(pending.object, *this);
+            }
+            this->_pending.clear();
+            this->_tracing = false;
+        }
+
+        return this->_failed ? nullptr : copy;
+    }
+
+    /// @brief Check whether promoting any object failed because there was insufficient space in either arena.
+    /// @remark After a failure, some pointers in the promoted objects may still point into the first arena or be NULL.
+    inline bool failed() const {
+        return this->_failed;
+    }
+
+private:
+    struct _PendingTrace {
+        void* object;
+        void (*trace)(void*, ArenaPromoter&);
+    };
+
+    // Promoted arrays, sorted by their start, so pointers into them can be forwarded too
+    struct _ForwardedRange {
+        const unsigned char* start;
+        const unsigned char* end;
+        unsigned char* copy;
+    };
+
+    inline bool _insertRange(const void* start, unsigned long size, void* copy) {
+        struct _ForwardedRange range = { (const unsigned char*) start, (const unsigned char*) start + size, (unsigned char*) copy };
+        if (!this->_ranges.pushBack(range)) {
+            return false;
+        }
+
+        unsigned long i = this->_ranges.size() - 1;
+        while (i > 0 && this->_ranges[i - 1].start > range.start) {
+            this->_ranges[i] = this->_ranges[i - 1];
+            i--;
+        }
+
+        this->_ranges[i] = range;
+        return true;
+    }
+
+    inline unsigned char* _findInterior(const void* pointer) {
+        unsigned long low = 0;
+        unsigned long high = this->_ranges.size();
+        while (low < high) {
+            unsigned long middle = low + (high - low) / 2;
+            if (this->_ranges[middle].start <= (const unsigned char*) pointer) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        if (low == 0 || (const unsigned char*) pointer >= this->_ranges[low - 1].end) {
+            return nullptr;
+        }
+
+        return this->_ranges[low - 1].copy + ((const unsigned char*) pointer - this->_ranges[low - 1].start);
+    }
+
+    template <typename T> static inline auto _callTrace(T* object, ArenaPromoter& promoter, int) -> decltype(object->trace(promoter), void()) {
+        object->trace(promoter);
+    }
+
+    template <typename T> static inline void _callTrace(T*, ArenaPromoter&, long) {}
+
+    template <typename T> static inline void _trace(void* object, ArenaPromoter& promoter) {
+        ArenaPromoter::_callTrace<T>((T*) object, promoter, 0);
+    }
+
+    struct PiggyBankArena* _from;
+    struct PiggyBankArena* _to;
+    unsigned char* _fromTop;
+    ArenaHashMap<const void*, void*> _forwarding;
+    ArenaVector<struct _ForwardedRange> _ranges;
+    ArenaVector<struct _PendingTrace> _pending;
+    bool _tracing;
+    bool _failed;
+};
+
+}
@@ -0,0 +1,741 @@
+/// PiggyBankArena: Allocate memory into a block which you free all at once.
+/// POSIX utilities for the C++ version of the library.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "PiggyBankArenaContainersCPP.hpp"
+
+namespace PiggyBankArena {
+
+/// @brief A range of consecutive file descriptors which are closed by one cleanup action.
+struct _PiggyBankArenaFileDescriptorRange {
+    int first;
+    int count;
+};
+
+/// @brief A range of consecutive mapped memory which is unmapped by one cleanup action.
+struct _PiggyBankArenaMappingRange {
+    unsigned char *start;
+    unsigned long length;
+};
+
+inline void _closeFileDescriptors(void* argument) {
+    struct _PiggyBankArenaFileDescriptorRange* range = (struct _PiggyBankArenaFileDescriptorRange*) argument;
+#ifdef SYS_close_range
+    if (range->count > 1 && syscall(SYS_close_range, (unsigned int) range->first, (unsigned int) (range->first + range->count - 1), 0) == 0) {
+        return;
+    }
+#endif
+
+    for (int fd = range->first + range->count - 1; fd >= range->first; fd--) {
+        close(fd);
+    }
+}
+
+inline void _unmapMemory(void* argument) {
+    struct _PiggyBankArenaMappingRange* range = (struct _PiggyBankArenaMappingRange*) argument;
+    munmap(range->start, range->length);
+}
+
+/// @brief Schedule a file descriptor to be closed when the arena is cleaned up.
+/// @remark File descriptors scheduled right after each other are grouped into one cleanup action if they are consecutive, and closed with a single close_range system call where it is available.
+/// @param arena A pointer to the arena.
+/// @param fd The file descriptor.
+/// @returns true on success, or false if there is not enough space in the arena for the cleanup action.
+inline bool scheduleClose(struct PiggyBankArena* arena, int fd) {
+    struct _PiggyBankArenaFileDescriptorRange* range = (struct _PiggyBankArenaFileDescriptorRange*) arena->lastCleanupArgument(&_closeFileDescriptors);
+    if (range != nullptr) {
+        if (fd == range->first + range->count) {
+            range->count++;
+            return true;
+        }
+
+        if (fd == range->first - 1) {
+            range->first--;
+            range->count++;
+            return true;
+        }
+    }
+
+    struct _PiggyBankArenaFileDescriptorRange newRange = { fd, 1 };
+    return arena->scheduleCleanupWithPayload(&_closeFileDescriptors, &newRange, sizeof(newRange)) != nullptr;
+}
+
+/// @brief Schedule mapped memory (e.g. from mmap) to be unmapped when the arena is cleaned up.
+/// @remark Mappings scheduled right after each other are grouped into one cleanup action if they are adjacent in memory, and unmapped with a single munmap call.
+/// @param arena A pointer to the arena.
+/// @param start A pointer to the start of the mapped memory.
+/// @param length The length of the mapped memory in bytes.
+/// @returns true on success, or false if there is not enough space in the arena for the cleanup action.
+inline bool scheduleUnmap(struct PiggyBankArena* arena, void* start, unsigned long length) {
+    struct _PiggyBankArenaMappingRange* range = (struct _PiggyBankArenaMappingRange*) arena->lastCleanupArgument(&_unmapMemory);
+    if (range != nullptr) {
+        if ((unsigned char*) start == range->start + range->length) {
+            range->length += length;
+            return true;
+        }
+
+        if ((unsigned char*) start + length == range->start) {
+            range->start = (unsigned char*) start;
+            range->length += length;
+            return true;
+        }
+    }
+
+    struct _PiggyBankArenaMappingRange newRange = { (unsigned char*) start, length };
+    return arena->scheduleCleanupWithPayload(&_unmapMemory, &newRange, sizeof(newRange)) != nullptr;
+}
+
+/// @brief Read the contents of a file into arena memory.
+/// @remark Regular files are read with their size taken from fstat. Files which report no size (e.g. pipes or files under /proc) are read until their end into whatever space is left in the arena. The contents are followed by a terminating zero, which is not counted in the size.
+/// @param arena A pointer to the arena.
+/// @param path The path of the file.
+/// @param size A pointer which receives the size of the contents in bytes.
+/// @returns a pointer to the contents, or NULL if the file cannot be read (errno tells why) or there is not enough space in the arena (errno is ENOMEM).
+inline void* readFile(struct PiggyBankArena* arena, const char* path, unsigned long* size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    bool sized = S_ISREG(status.st_mode) && status.st_size > 0;
+    // Leave room for the terminating zero
+    unsigned long capacity = sized ? (unsigned long) status.st_size : arena->remainingSpace();
+    unsigned char* result = (unsigned char*) arena->reserve(sized ? capacity + 1 : capacity);
+    if (!sized && capacity != 0) {
+        capacity--;
+    }
+
+    if (result == nullptr) {
+        close(fd);
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    unsigned long length = 0;
+    while (length < capacity) {
+        ssize_t count = read(fd, result + length, capacity - length);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            int error = errno;
+            close(fd);
+            errno = error;
+            return nullptr;
+        }
+
+        if (count == 0) {
+            break;
+        }
+
+        length += (unsigned long) count;
+    }
+
+    if (!sized && length == capacity) {
+        close(fd);
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    close(fd);
+    result[length] = 0;
+    arena->commit(length + 1);
+    *size = length;
+    return result;
+}
+
+/// @brief Map a file into memory read-only, and schedule it to be unmapped when the arena is cleaned up.
+/// @remark Nothing is copied into the arena, which makes this suitable for large files. Empty files cannot be mapped, so for them a pointer to no memory in the arena is returned. Other files which report a size of 0 (like those in /proc or character devices) are not empty, but cannot be mapped either, so this fails with EINVAL for them; read them with readFile instead.
+/// @param arena A pointer to the arena.
+/// @param path The path of the file.
+/// @param size A pointer which receives the size of the file in bytes.
+/// @returns a pointer to the mapped contents, or NULL if the file cannot be mapped (errno tells why) or there is not enough space in the arena for the cleanup action (errno is ENOMEM).
+inline const void* mapFile(struct PiggyBankArena* arena, const char* path, unsigned long* size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    if (status.st_size == 0) {
+        // Files in /proc and /sys are regular files which report a size of 0 without being empty
+        char probe;
+        ssize_t count = S_ISREG(status.st_mode) ? pread(fd, &probe, 1, 0) : 1;
+        int error = errno;
+        close(fd);
+        if (count != 0) {
+            errno = count < 0 ? error : EINVAL;
+            return nullptr;
+        }
+
+        *size = 0;
+        return arena->heapTop;
+    }
+
+    void* result = mmap(nullptr, (unsigned long) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    close(fd);
+    if (result == MAP_FAILED) {
+        errno = error;
+        return nullptr;
+    }
+
+    if (!scheduleUnmap(arena, result, (unsigned long) status.st_size)) {
+        munmap(result, (unsigned long) status.st_size);
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    *size = (unsigned long) status.st_size;
+    return result;
+}
+
+/// @brief The start of an arena image file. The arena's used memory follows at dataOffset, and then the relocation table.
+struct _PiggyBankArenaImageHeader {
+    unsigned long long magic;
+    unsigned long long arenaHeaderSize;
+    unsigned long long dataOffset;
+    unsigned long long base;
+    unsigned long long size;
+    unsigned long long used;
+    unsigned long long relocationCount;
+};
+
+static const unsigned long long _PIGGYBANKARENA_IMAGE_MAGIC = 0x31474D4959474950ULL;
+
+inline bool _writeAll(int fd, const void* data, unsigned long length, unsigned long long offset) {
+    while (length != 0) {
+        ssize_t count = pwrite(fd, data, length, (off_t) offset);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        data = (const unsigned char*) data + count;
+        length -= (unsigned long) count;
+        offset += (unsigned long long) count;
+    }
+
+    return true;
+}
+
+inline bool _readAll(int fd, void* data, unsigned long length, unsigned long long offset) {
+    while (length != 0) {
+        ssize_t count = pread(fd, data, length, (off_t) offset);
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (count == 0) {
+                errno = EINVAL;
+            }
+
+            return false;
+        }
+
+        data = (unsigned char*) data + count;
+        length -= (unsigned long) count;
+        offset += (unsigned long long) count;
+    }
+
+    return true;
+}
+
+/// @brief Save the header and heap of an arena to an image file, which loadImage() can map back into memory.
+/// @remark Raw pointers stored in the heap must be registered, so they can be adjusted if the image is loaded at a different address. Only arenas which start on a page boundary (e.g. in memory from mmap) can be loaded at their old address without adjusting. Offset pointers and other position-independent data need no registration. Cleanup actions cannot be saved, so the arena must not have any.
+/// @param arena A pointer to the arena.
+/// @param path The path of the image file, which is created or overwritten.
+/// @param pointerLocations The addresses of the raw pointers in the heap which point into the arena. NULL pointers stay NULL.
+/// @param pointerCount The number of raw pointers.
+/// @returns true on success, false if the image cannot be written (errno tells why), or if the arena has cleanup actions or a pointer location is misaligned or outside of its heap (errno is EINVAL).
+inline bool saveImage(struct PiggyBankArena* arena, const char* path, void* const* pointerLocations = nullptr, unsigned long pointerCount = 0) {
+    if (arena->cleanupActionsBottom != arena->end || arena->cleanupBlocks != nullptr) {
+        errno = EINVAL;
+        return false;
+    }
+
+    for (unsigned long i = 0; i < pointerCount; i++) {
+        if ((unsigned char*) pointerLocations[i] < arena->start || (unsigned char*) pointerLocations[i] + sizeof(void*) > arena->heapTop || (uintptr_t) pointerLocations[i] % alignof(void*) != 0) {
+            errno = EINVAL;
+            return false;
+        }
+    }
+
+    struct _PiggyBankArenaImageHeader header;
+    header.magic = _PIGGYBANKARENA_IMAGE_MAGIC;
+    header.arenaHeaderSize = sizeof (struct PiggyBankArena);
+    header.dataOffset = (unsigned long long) sysconf(_SC_PAGESIZE);
+    header.base = (unsigned long long) (unsigned long) arena;
+    header.size = (unsigned long long) ((unsigned char*) arena->end - (unsigned char*) arena);
+    header.used = (unsigned long long) (arena->heapTop - (unsigned char*) arena);
+    header.relocationCount = pointerCount;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool result = _writeAll(fd, &header, sizeof(header), 0) && _writeAll(fd, arena, (unsigned long) header.used, header.dataOffset);
+    unsigned long long offset = header.dataOffset + header.used;
+    for (unsigned long i = 0; result && i < pointerCount; i++) {
+        unsigned long long relocation = (unsigned long long) ((unsigned char*) pointerLocations[i] - (unsigned char*) arena);
+        result = _writeAll(fd, &relocation, sizeof(relocation), offset);
+        offset += sizeof(relocation);
+    }
+
+    int error = errno;
+    if (close(fd) != 0 && result) {
+        return false;
+    }
+
+    errno = error;
+    return result;
+}
+
+/// @brief Load an arena image written by saveImage().
+/// @remark The image is mapped copy-on-write, so its pages are only read from the file when they are used. It is mapped at the address the arena had when it was saved if that address is page-aligned and free, in which case nothing is adjusted. Otherwise, the registered raw pointers are adjusted to the new address.
+/// @remark The loaded arena has no cleanup actions, and can be used like any other. Release it with unloadImage().
+/// @param path The path of the image file.
+/// @returns a pointer to the loaded arena, or NULL if the image cannot be read or mapped (errno tells why) or is not a valid image, e.g. because it was truncated (errno is EINVAL).
+inline struct PiggyBankArena* loadImage(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct _PiggyBankArenaImageHeader header;
+    unsigned long pageSize = (unsigned long) sysconf(_SC_PAGESIZE);
+    if (!_readAll(fd, &header, sizeof(header), 0)) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    // A file too short for the heap would map without error, but fail with SIGBUS when the missing pages are touched
+    unsigned long long fileSize = (unsigned long long) status.st_size;
+    if (header.magic != _PIGGYBANKARENA_IMAGE_MAGIC || header.arenaHeaderSize != sizeof (struct PiggyBankArena) || header.dataOffset % pageSize != 0 || header.used < sizeof (struct PiggyBankArena) || header.used > header.size) {
+        close(fd);
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    if (header.dataOffset > fileSize || header.used > fileSize - header.dataOffset || header.relocationCount > (fileSize - header.dataOffset - header.used) / sizeof (unsigned long long)) {
+        close(fd);
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    // Mappings start on a page boundary, so an arena which did not can never get its old address back
+    unsigned long size = (unsigned long) header.size;
+    void* hint = header.base % pageSize == 0 ? (void*) (unsigned long) header.base : nullptr;
+    unsigned char* base = (unsigned char*) mmap(hint, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    if (mmap(base, (unsigned long) header.used, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, (off_t) header.dataOffset) == MAP_FAILED) {
+        int error = errno;
+        munmap(base, size);
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    struct PiggyBankArena* arena = (struct PiggyBankArena*) base;
+    arena->end = base + size;
+    arena->heapTop = base + header.used;
+    arena->cleanupActionsBottom = (struct _PiggyBankArenaCleanupAction*) arena->end;
+    for (unsigned int phase = 0; phase < PIGGYBANKARENA_CLEANUP_PHASES; phase++) {
+        arena->cleanupPhases[phase] = nullptr;
+    }
+    arena->cleanupBlocks = nullptr;
+
+    unsigned long delta = (unsigned long) base - (unsigned long) header.base;
+    if (delta != 0) {
+        unsigned long long relocations[512];
+        unsigned long long offset = header.dataOffset + header.used;
+        for (unsigned long long done = 0; done < header.relocationCount; ) {
+            unsigned long count = header.relocationCount - done < 512 ? (unsigned long) (header.relocationCount - done) : 512;
+            if (!_readAll(fd, relocations, count * sizeof(relocations[0]), offset)) {
+                int error = errno;
+                munmap(base, size);
+                close(fd);
+                errno = error;
+                return nullptr;
+            }
+
+            for (unsigned long i = 0; i < count; i++) {
+                if (relocations[i] < sizeof (struct PiggyBankArena) || relocations[i] > header.used - sizeof(void*) || relocations[i] % alignof(void*) != 0) {
+                    munmap(base, size);
+                    close(fd);
+                    errno = EINVAL;
+                    return nullptr;
+                }
+
+                unsigned long* pointer = (unsigned long*) (base + relocations[i]);
+                if (*pointer != 0) {
+                    *pointer += delta;
+                }
+            }
+
+            done += count;
+            offset += count * sizeof(relocations[0]);
+        }
+    }
+
+    close(fd);
+    return arena;
+}
+
+/// @brief Clean up an arena loaded by loadImage() and unmap its memory.
+/// @param arena A pointer to the arena.
+inline void unloadImage(struct PiggyBankArena* arena) {
+    arena->cleanup();
+    munmap(arena, (unsigned long) ((unsigned char*) arena->end - (unsigned char*) arena));
+}
+
+/// @brief An arena in shared memory, which several processes can allocate from concurrently. It looks like this: [{Header} {Heap (grows up) ->} ...]
+/// @remark Processes may map the shared memory at different addresses, so the header holds offsets instead of pointers, and data in the heap should link to other data through offsets (e.g. OffsetPtr). Function pointers are only valid in the process they come from, so a shared arena has no cleanup actions - schedule them on a process-local arena instead.
+struct PiggyBankSharedArena {
+    unsigned long long size;
+    std::atomic<unsigned long long> top;
+    unsigned char start[];
+
+    static_assert(std::atomic<unsigned long long>::is_always_lock_free, "Shared arenas need lock-free atomics");
+
+    // The arena object is not created using constructors or destructors, but using a factory method
+    PiggyBankSharedArena() = delete;
+
+    /// @brief Initialize a shared arena in some user-provided (shared) memory.
+    /// @remark Only one process initializes the arena, the others use it as it is once it is mapped.
+    /// @param memory A pointer to the memory that will be used by the arena.
+    /// @param size The size of the memory in bytes.
+    /// @returns a pointer to an initialized arena, or NULL if the provided memory is not large enough.
+    static inline struct PiggyBankSharedArena* init(void* memory, unsigned long size) {
+        if (size <= sizeof (struct PiggyBankSharedArena)) {
+            return (struct PiggyBankSharedArena*) nullptr;
+        }
+
+        struct PiggyBankSharedArena* result = (struct PiggyBankSharedArena*) memory;
+        result->size = size;
+        new (&result->top) std::atomic<unsigned long long>(sizeof (struct PiggyBankSharedArena));
+        return result;
+    }
+
+    /// @brief Query how much space is remaining in the arena.
+    /// @returns the space in bytes remaining in the arena, which may already be less by the time it is used if other processes allocate concurrently.
+    inline unsigned long remainingSpace() {
+        return (unsigned long) (this->size - this->top.load(std::memory_order_relaxed));
+    }
+
+    /// @brief Allocate memory from the arena. This is safe to do from several processes (or threads) at the same time.
+    /// @param size The amount of memory in bytes.
+    /// @returns a pointer to the allocated memory, or NULL if there is not enough space in the arena for the given size.
+    inline void* alloc(unsigned long size) {
+        unsigned long long top = this->top.load(std::memory_order_relaxed);
+        do {
+            if (this->size - top < size) {
+                return nullptr;
+            }
+        } while (!this->top.compare_exchange_weak(top, top + size, std::memory_order_relaxed));
+
+        return (unsigned char*) this + top;
+    }
+
+    /// @brief Get the offset of memory in the arena from the arena's start, which is the same in every process.
+    inline unsigned long offsetOf(const void* pointer) {
+        return (unsigned long) ((const unsigned char*) pointer - (unsigned char*) this);
+    }
+
+    /// @brief Get a pointer to the memory at the given offset from the arena's start in this process.
+    inline void* at(unsigned long offset) {
+        return (unsigned char*) this + offset;
+    }
+
+    /// @brief Reset the arena to an empty state.
+    /// @remark No process may use memory from the arena anymore, or allocate from it at the same time.
+    inline void reset() {
+        this->top.store(sizeof (struct PiggyBankSharedArena), std::memory_order_relaxed);
+    }
+};
+
+/// @brief Map shared memory holding a shared arena, which is either initialized or (if it comes from another process) validated, and schedule it to be unmapped.
+inline struct PiggyBankSharedArena* _mapSharedMemory(struct PiggyBankArena* arena, int fd, unsigned long size, bool initialize) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    struct PiggyBankSharedArena* shared;
+    if (initialize) {
+        shared = PiggyBankSharedArena::init(memory, size);
+    } else {
+        // An arena larger than the memory would let allocations run past the mapping
+        shared = (struct PiggyBankSharedArena*) memory;
+        unsigned long long top = shared->top.load(std::memory_order_relaxed);
+        if (shared->size > size || top < sizeof (struct PiggyBankSharedArena) || top > shared->size) {
+            munmap(memory, size);
+            errno = EINVAL;
+            return nullptr;
+        }
+    }
+
+    if (!scheduleUnmap(arena, memory, size)) {
+        munmap(memory, size);
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    return shared;
+}
+
+/// @brief Map a shared arena from a file descriptor (e.g. one passed from another process) into this process.
+/// @remark The memory is unmapped when the given process-local arena is cleaned up. The file descriptor can be closed right after this.
+/// @param arena A pointer to the process-local arena.
+/// @param fd The file descriptor of the shared memory.
+/// @returns a pointer to the shared arena, or NULL if it cannot be mapped (errno tells why), does not hold a valid shared arena (errno is EINVAL) or there is not enough space in the local arena for the cleanup action (errno is ENOMEM).
+inline struct PiggyBankSharedArena* mapSharedArena(struct PiggyBankArena* arena, int fd) {
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        return nullptr;
+    }
+
+    if ((unsigned long) status.st_size <= sizeof (struct PiggyBankSharedArena)) {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    return _mapSharedMemory(arena, fd, (unsigned long) status.st_size, false);
+}
+
+/// @brief Create a shared arena in new shared memory and map it into this process.
+/// @remark Named shared memory is created with shm_open and can be opened by name from other processes (remove it with shm_unlink when it is no longer needed). Anonymous shared memory is created with memfd_create (on Linux), and its file descriptor can be passed to other processes, e.g. by forking or over a UNIX domain socket.
+/// @remark The memory is unmapped and the file descriptor is closed when the given process-local arena is cleaned up.
+/// @param arena A pointer to the process-local arena.
+/// @param size The size of the shared memory in bytes.
+/// @param name The name of the shared memory (starting with a slash), or NULL for anonymous shared memory.
+/// @param fd A pointer which receives the file descriptor of the shared memory, or NULL.
+/// @returns a pointer to the shared arena, or NULL if it cannot be created (errno tells why) or there is not enough space in the local arena for the cleanup actions (errno is ENOMEM).
+inline struct PiggyBankSharedArena* createSharedArena(struct PiggyBankArena* arena, unsigned long size, const char* name = nullptr, int* fd = nullptr) {
+    if (size <= sizeof (struct PiggyBankSharedArena)) {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    int sharedFd;
+    if (name != nullptr) {
+        sharedFd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    } else {
+#ifdef MFD_CLOEXEC
+        sharedFd = memfd_create("PiggyBankSharedArena", MFD_CLOEXEC);
+#else
+        errno = ENOSYS;
+        sharedFd = -1;
+#endif
+    }
+
+    if (sharedFd < 0) {
+        return nullptr;
+    }
+
+    struct PiggyBankSharedArena* result = nullptr;
+    if (ftruncate(sharedFd, (off_t) size) == 0) {
+        result = _mapSharedMemory(arena, sharedFd, size, true);
+    }
+
+    // The mapping stays scheduled to be unmapped if the file descriptor cannot be scheduled to be closed
+    if (result != nullptr && !scheduleClose(arena, sharedFd)) {
+        result = nullptr;
+        errno = ENOMEM;
+    }
+
+    if (result == nullptr) {
+        int error = errno;
+        close(sharedFd);
+        if (name != nullptr) {
+            shm_unlink(name);
+        }
+
+        errno = error;
+        return nullptr;
+    }
+
+    if (fd != nullptr) {
+        *fd = sharedFd;
+    }
+
+    return result;
+}
+
+/// @brief A chain of output fragments in memory, which can be written out with a single writev call.
+/// @remark The fragments are not copied, only recorded - they must stay valid until the chain is written (e.g. by being allocated from the arena). Fragments which directly follow each other in memory are merged. The fragment list itself is allocated from the arena.
+class ArenaOutputChain {
+public:
+    /// @brief Create an empty chain.
+    /// @param arena A pointer to the arena which the fragment list (and copied fragments) are allocated from. It must outlive the chain.
+    inline ArenaOutputChain(struct PiggyBankArena* arena) : _arena(arena), _fragments(arena), _length(0) {}
+
+    ArenaOutputChain(const ArenaOutputChain&) = delete;
+    ArenaOutputChain& operator=(const ArenaOutputChain&) = delete;
+
+    /// @brief Append a fragment to the chain without copying it.
+    /// @param data A pointer to the fragment.
+    /// @param length The length of the fragment in bytes.
+    /// @returns true on success, false if there is insufficient space in the arena.
+    inline bool append(const void* data, unsigned long length) {
+        if (length == 0) {
+            return true;
+        }
+
+        unsigned long count = this->_fragments.size();
+        if (count != 0 && (const unsigned char*) this->_fragments[count - 1].iov_base + this->_fragments[count - 1].iov_len == data) {
+            this->_fragments[count - 1].iov_len += length;
+        } else {
+            struct iovec fragment;
+            fragment.iov_base = (void*) data;
+            fragment.iov_len = length;
+            if (!this->_fragments.pushBack(fragment)) {
+                return false;
+            }
+        }
+
+        this->_length += length;
+        return true;
+    }
+
+    /// @brief Append a fragment to the chain, copying it into the arena first (e.g. for short-lived data).
+    /// @param data A pointer to the fragment.
+    /// @param length The length of the fragment in bytes.
+    /// @returns true on success, false if there is insufficient space in the arena.
+    inline bool appendCopy(const void* data, unsigned long length) {
+        unsigned char* heapTop = this->_arena->heapTop;
+        void* copy = this->_arena->alloc(length);
+        if (copy == nullptr) {
+            return false;
+        }
+
+        memcpy(copy, data, length);
+        if (!this->append(copy, length)) {
+            this->_arena->heapTop = heapTop;
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Get the fragments as an array which can be passed to writev or sendmsg.
+    inline struct iovec* iovecs() {
+        return this->_fragments.data();
+    }
+
+    /// @brief Get the number of fragments.
+    inline unsigned long count() const {
+        return this->_fragments.size();
+    }
+
+    /// @brief Get the total length of all fragments in bytes.
+    inline unsigned long length() const {
+        return this->_length;
+    }
+
+    /// @brief Remove all fragments from the chain, e.g. to give up on writing them after an error.
+    inline void clear() {
+        this->_fragments.clear();
+        this->_length = 0;
+    }
+
+    /// @brief Write all fragments to a file descriptor with as few writev calls as possible.
+    /// @remark Partial writes and interrupted calls are continued. Written fragments are removed from the chain, so on failure it holds what is left to write, and writing can be retried (e.g. once a non-blocking socket failing with EAGAIN is writable again).
+    /// @param fd The file descriptor.
+    /// @returns true if everything was written, false if writing failed (errno tells why).
+    inline bool writeTo(int fd) {
+        struct iovec* fragments = this->_fragments.data();
+        unsigned long count = this->_fragments.size();
+        bool result = true;
+        while (count != 0) {
+            ssize_t written = writev(fd, fragments, (int) (count < IOV_MAX ? count : IOV_MAX));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                result = false;
+                break;
+            }
+
+            this->_length -= (unsigned long) written;
+            while (count != 0 && (unsigned long) written >= fragments->iov_len) {
+                written -= (ssize_t) fragments->iov_len;
+                fragments++;
+                count--;
+            }
+
+            if (count != 0) {
+                fragments->iov_base = (unsigned char*) fragments->iov_base + written;
+                fragments->iov_len -= (unsigned long) written;
+            }
+        }
+
+        // Keep the fragments which were not written at the front of the list
+        struct iovec* first = this->_fragments.data();
+        if (fragments != first) {
+            memmove(first, fragments, count * sizeof (struct iovec));
+            while (this->_fragments.size() > count) {
+                this->_fragments.popBack();
+            }
+        }
+
+        return result;
+    }
+
+private:
+    struct PiggyBankArena* _arena;
+    ArenaVector<struct iovec> _fragments;
+    unsigned long _length;
+};
+
+}
@@ -1,5 +1,8 @@
 #define CONFIG_CATCH_MAIN
 
+#include <stdint.h>
+#include <stdlib.h>
+
 #include "catch2/catch_amalgamated.hpp"
 #include "PiggyBankArenaC.h"
 
@@ -72,3 +75,353 @@ TEST_CASE( "Arena cleanup actions (C)" ) {
     REQUIRE(arena->end == arena->start + 3*sizeof(_PiggyBankArenaCleanupAction));
     REQUIRE(arena->cleanupActionsBottom == arena->end);
 }
+
+TEST_CASE( "Arena reserve and commit (C)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 3*sizeof(_TestStruct)];
+    PiggyBankArena *arena = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    REQUIRE(PiggyBankArenaReserve(arena, 4*sizeof(_TestStruct)) == NULL);
+    REQUIRE(PiggyBankArenaReserve(arena, 3*sizeof(_TestStruct)) == arena->start);
+    REQUIRE(arena->heapTop == arena->start);
+
+    REQUIRE(PiggyBankArenaCommit(arena, sizeof(_TestStruct)) == arena->start);
+    REQUIRE(arena->heapTop == arena->start + sizeof(_TestStruct));
+    REQUIRE(PiggyBankArenaReserve(arena, 3*sizeof(_TestStruct)) == NULL);
+    REQUIRE(PiggyBankArenaReserve(arena, 2*sizeof(_TestStruct)) == arena->start + sizeof(_TestStruct));
+    REQUIRE(PiggyBankArenaCommit(arena, 3*sizeof(_TestStruct)) == NULL);
+    REQUIRE(PiggyBankArenaCommit(arena, 0) == arena->start + sizeof(_TestStruct));
+    REQUIRE(arena->heapTop == arena->start + sizeof(_TestStruct));
+
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(arena->heapTop == arena->start);
+}
+
+TEST_CASE( "Arena cursor allocation (C)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 4*sizeof(_TestStruct)];
+    PiggyBankArena *arena = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    PiggyBankArenaCursor cursor = PiggyBankArenaReserveCursor(arena, 5*sizeof(_TestStruct));
+    REQUIRE(cursor.top == NULL);
+    REQUIRE(cursor.end == NULL);
+
+    cursor = PiggyBankArenaReserveCursor(arena, 3*sizeof(_TestStruct));
+    REQUIRE(cursor.top == arena->start);
+    REQUIRE(cursor.end == arena->start + 3*sizeof(_TestStruct));
+    REQUIRE(arena->heapTop == cursor.end);
+
+    REQUIRE(PiggyBankArenaCursorAlloc(&cursor, sizeof(_TestStruct)) == arena->start);
+    REQUIRE(PiggyBankArenaCursorAlloc(&cursor, sizeof(_TestStruct)) == arena->start + sizeof(_TestStruct));
+    PiggyBankArenaReleaseCursor(arena, &cursor);
+    REQUIRE(arena->heapTop == arena->start + 2*sizeof(_TestStruct));
+
+    // Unused memory is not given back if something was allocated after the cursor
+    cursor = PiggyBankArenaReserveCursor(arena, sizeof(_TestStruct));
+    REQUIRE(PiggyBankArenaAlloc(arena, sizeof(_TestStruct)) == arena->start + 3*sizeof(_TestStruct));
+    PiggyBankArenaReleaseCursor(arena, &cursor);
+    REQUIRE(arena->heapTop == arena->start + 4*sizeof(_TestStruct));
+
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(arena->heapTop == arena->start);
+}
+
+TEST_CASE( "Child arenas (C)" ) {
+    const unsigned long childSize = sizeof(PiggyBankArena) + sizeof(_TestStruct) + sizeof(_PiggyBankArenaCleanupAction);
+    char memBuffer[sizeof(PiggyBankArena) + 2*childSize + sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *parent = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(parent != nullptr);
+
+    REQUIRE(PiggyBankArenaMakeChild(parent, sizeof(PiggyBankArena)) == NULL);
+    REQUIRE(parent->heapTop == parent->start);
+
+    PiggyBankArena *child = PiggyBankArenaMakeChild(parent, childSize);
+    REQUIRE(child == (PiggyBankArena*) parent->start);
+    REQUIRE(child->end == parent->start + childSize);
+    REQUIRE(parent->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)parent->end - 1);
+
+    // No space left in the parent for the second child's cleanup action
+    REQUIRE(PiggyBankArenaMakeChild(parent, childSize) == NULL);
+    REQUIRE(parent->heapTop == parent->start + childSize);
+
+    int cleanup1 = 0;
+    int cleanup2 = 0;
+    REQUIRE(PiggyBankArenaAlloc(child, sizeof(_TestStruct)) == child->start);
+    REQUIRE(PiggyBankArenaScheduleCleanup(child, &logCleanupFunction, &cleanup1));
+    PiggyBankArenaCleanup(child);
+    REQUIRE(cleanup1 == 42);
+    REQUIRE(child->heapTop == child->start);
+
+    REQUIRE(PiggyBankArenaScheduleCleanup(child, &logCleanupFunction, &cleanup2));
+    PiggyBankArenaCleanup(parent);
+    REQUIRE(cleanup2 == 42);
+    REQUIRE(child->cleanupActionsBottom == child->end);
+    REQUIRE(parent->heapTop == parent->start);
+    REQUIRE(parent->cleanupActionsBottom == parent->end);
+}
+
+TEST_CASE( "Arena splitting (C)" ) {
+    const unsigned long childSize = sizeof(PiggyBankArena) + sizeof(_PiggyBankArenaCleanupAction);
+    char memBuffer[sizeof(PiggyBankArena) + sizeof(_TestStruct) + 3*(childSize + sizeof(_PiggyBankArenaCleanupAction)) + 2];
+    PiggyBankArena *parent = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(parent != nullptr);
+    REQUIRE(PiggyBankArenaAlloc(parent, sizeof(_TestStruct)) == parent->start);
+
+    PiggyBankArena *children[5] = {0};
+    REQUIRE(PiggyBankArenaSplit(parent, 0, children) == 0);
+    REQUIRE(PiggyBankArenaSplit(parent, 5, children) == 0);
+    REQUIRE(children[0] == NULL);
+    REQUIRE(parent->heapTop == parent->start + sizeof(_TestStruct));
+
+    REQUIRE(PiggyBankArenaSplit(parent, 3, children) == 3);
+    REQUIRE(PiggyBankArenaRemainingSpace(parent) == 2);
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(children[i] == (PiggyBankArena*) (parent->start + sizeof(_TestStruct) + i*childSize));
+        REQUIRE(children[i]->end == (unsigned char*) children[i] + childSize);
+    }
+
+    int cleanups[3] = {0};
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(PiggyBankArenaScheduleCleanup(children[i], &logCleanupFunction, &cleanups[i]));
+    }
+
+    PiggyBankArenaCleanup(parent);
+    REQUIRE(cleanups[0] == 42);
+    REQUIRE(cleanups[1] == 42);
+    REQUIRE(cleanups[2] == 42);
+    REQUIRE(parent->heapTop == parent->start);
+    REQUIRE(parent->cleanupActionsBottom == parent->end);
+}
+
+TEST_CASE( "Arena adopting other arenas (C)" ) {
+    char ownerBuffer[sizeof(PiggyBankArena) + 3*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *owner = PiggyBankArenaInit(ownerBuffer, sizeof(ownerBuffer));
+    REQUIRE(owner != nullptr);
+
+    PiggyBankArena *workers[2];
+    int cleanups[2] = {0};
+    for (int i = 0; i < 2; i++) {
+        const unsigned long size = sizeof(PiggyBankArena) + sizeof(_PiggyBankArenaCleanupAction);
+        workers[i] = PiggyBankArenaInit(malloc(size), size);
+        REQUIRE(workers[i] != nullptr);
+        REQUIRE(PiggyBankArenaScheduleCleanup(workers[i], &logCleanupFunction, &cleanups[i]));
+    }
+
+    REQUIRE(PiggyBankArenaAdopt(owner, workers[0], &free) == (_PiggyBankArenaCleanupAction*)owner->end - 2);
+    // Not enough space for both cleanup actions
+    REQUIRE(PiggyBankArenaAdopt(owner, workers[1], &free) == NULL);
+    REQUIRE(owner->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)owner->end - 2);
+    REQUIRE(PiggyBankArenaAdopt(owner, workers[1], NULL) == (_PiggyBankArenaCleanupAction*)owner->end - 3);
+
+    PiggyBankArenaCleanup(owner);
+    REQUIRE(cleanups[0] == 42);
+    REQUIRE(cleanups[1] == 42);
+    REQUIRE(owner->cleanupActionsBottom == owner->end);
+    free(workers[1]);
+}
+
+struct _TestPayload {
+    int *log;
+    int value;
+};
+
+void logPayloadCleanupFunction(void *payload) {
+    struct _TestPayload *testPayload = (struct _TestPayload*) payload;
+    *testPayload->log = *testPayload->log * 10 + testPayload->value;
+}
+
+TEST_CASE( "Arena cleanup actions with payload (C)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 6*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int log = 0;
+    struct _TestPayload payload1 = { &log, 1 };
+    struct _TestPayload payload2 = { &log, 2 };
+    REQUIRE(sizeof(_TestPayload) <= sizeof(_PiggyBankArenaCleanupAction));
+
+    _PiggyBankArenaCleanupAction *action = PiggyBankArenaScheduleCleanupWithPayload(arena, &logPayloadCleanupFunction, &payload1, sizeof(payload1));
+    REQUIRE(action == (_PiggyBankArenaCleanupAction*)arena->end - 3);
+    REQUIRE(action->argument == action + 2);
+    REQUIRE(PiggyBankArenaScheduleCleanup(arena, &logCleanupFunction, &log) == (_PiggyBankArenaCleanupAction*)arena->end - 4);
+    REQUIRE(PiggyBankArenaScheduleCleanupWithPayload(arena, &logPayloadCleanupFunction, &payload2, sizeof(payload2)) == NULL);
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 4);
+
+    // The payload was copied, so changing the original has no effect
+    payload1.value = 3;
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(log == 421);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+TEST_CASE( "Arena cancelling cleanup actions (C)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 6*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int cleanup1 = 0;
+    int cleanup2 = 0;
+    int cleanup3 = 0;
+    struct _TestPayload payload = { &cleanup3, 1 };
+
+    _PiggyBankArenaCleanupAction *action1 = PiggyBankArenaScheduleCleanup(arena, &logCleanupFunction, &cleanup1);
+    _PiggyBankArenaCleanupAction *action2 = PiggyBankArenaScheduleCleanupWithPayload(arena, &logPayloadCleanupFunction, &payload, sizeof(payload));
+    _PiggyBankArenaCleanupAction *action3 = PiggyBankArenaScheduleCleanup(arena, &logCleanupFunction, &cleanup2);
+    REQUIRE(action3 == (_PiggyBankArenaCleanupAction*)arena->end - 5);
+
+    // Cancelling an action in the middle of the stack only disables it
+    PiggyBankArenaCancelCleanup(arena, action2);
+    REQUIRE(action2->func == NULL);
+    REQUIRE(arena->cleanupActionsBottom == action3);
+
+    // Cancelling the most recent action pops it, along with the cancelled actions below it
+    PiggyBankArenaCancelCleanup(arena, action3);
+    REQUIRE(arena->cleanupActionsBottom == action1);
+
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(cleanup1 == 42);
+    REQUIRE(cleanup2 == 0);
+    REQUIRE(cleanup3 == 0);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+
+    action1 = PiggyBankArenaScheduleCleanup(arena, &logCleanupFunction, &cleanup2);
+    PiggyBankArenaCancelCleanup(arena, action1);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(cleanup2 == 0);
+}
+
+TEST_CASE( "Arena cleanup phases (C)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 20*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int log = 0;
+    struct _TestPayload payloads[6] = {{&log, 1}, {&log, 2}, {&log, 3}, {&log, 4}, {&log, 5}, {&log, 6}};
+
+    REQUIRE(PiggyBankArenaScheduleCleanupInPhase(arena, PIGGYBANKARENA_CLEANUP_PHASES, &logPayloadCleanupFunction, &payloads[0]) == NULL);
+    REQUIRE(PiggyBankArenaScheduleCleanupInPhase(arena, 1, &logPayloadCleanupFunction, &payloads[0]) == (_PiggyBankArenaCleanupAction*)arena->end - 2);
+    REQUIRE(PiggyBankArenaScheduleCleanup(arena, &logPayloadCleanupFunction, &payloads[1]) == (_PiggyBankArenaCleanupAction*)arena->end - 4);
+    REQUIRE(PiggyBankArenaScheduleCleanupInPhase(arena, 0, &logPayloadCleanupFunction, &payloads[2]));
+    REQUIRE(PiggyBankArenaScheduleCleanupInPhase(arena, 1, &logPayloadCleanupFunction, &payloads[3]));
+    REQUIRE(PiggyBankArenaScheduleCleanupInPhase(arena, 0, &logPayloadCleanupFunction, &payloads[4]));
+
+    // Cancelled phased actions are skipped, but their space is not given back
+    _PiggyBankArenaCleanupAction *cancelled = PiggyBankArenaScheduleCleanupInPhase(arena, 0, &logPayloadCleanupFunction, &payloads[5]);
+    REQUIRE(cancelled == (_PiggyBankArenaCleanupAction*)arena->end - 15);
+    PiggyBankArenaCancelCleanup(arena, cancelled);
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 16);
+
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(log == 53412);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+    for (int phase = 0; phase < PIGGYBANKARENA_CLEANUP_PHASES; phase++) {
+        REQUIRE(arena->cleanupPhases[phase] == NULL);
+    }
+
+    log = 0;
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(log == 0);
+}
+
+TEST_CASE( "Arena cleanup blocks (C)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 2*sizeof(_TestStruct) + sizeof(_PiggyBankArenaCleanupAction)];
+    char blockBuffer1[sizeof(_PiggyBankArenaCleanupBlock) + 2*sizeof(_PiggyBankArenaCleanupAction)];
+    char blockBuffer2[sizeof(_PiggyBankArenaCleanupBlock) + 3*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int log = 0;
+    struct _TestPayload payloads[4] = {{&log, 1}, {&log, 2}, {&log, 3}, {&log, 4}};
+    REQUIRE(PiggyBankArenaScheduleCleanup(arena, &logPayloadCleanupFunction, &payloads[0]) == (_PiggyBankArenaCleanupAction*)arena->end - 1);
+
+    REQUIRE(PiggyBankArenaAddCleanupBlock(arena, blockBuffer1, sizeof(_PiggyBankArenaCleanupBlock)) == NULL);
+    _PiggyBankArenaCleanupBlock *block1 = PiggyBankArenaAddCleanupBlock(arena, blockBuffer1, sizeof(blockBuffer1));
+    REQUIRE(block1 == (_PiggyBankArenaCleanupBlock*) blockBuffer1);
+    REQUIRE(arena->cleanupBlocks == block1);
+    REQUIRE(block1->previous == NULL);
+
+    // Cleanup actions go into the block, leaving the arena's space for the heap
+    REQUIRE(PiggyBankArenaScheduleCleanup(arena, &logPayloadCleanupFunction, &payloads[1]) == (_PiggyBankArenaCleanupAction*)block1->end - 1);
+    REQUIRE(PiggyBankArenaScheduleCleanup(arena, &logPayloadCleanupFunction, &payloads[2]) == (_PiggyBankArenaCleanupAction*)block1->end - 2);
+    REQUIRE(PiggyBankArenaScheduleCleanup(arena, &logPayloadCleanupFunction, &payloads[3]) == NULL);
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 1);
+    REQUIRE(PiggyBankArenaAlloc(arena, 2*sizeof(_TestStruct)) == arena->start);
+
+    _PiggyBankArenaCleanupBlock *block2 = PiggyBankArenaAddCleanupBlock(arena, blockBuffer2, sizeof(blockBuffer2));
+    REQUIRE(block2->previous == block1);
+    _PiggyBankArenaCleanupAction *action = PiggyBankArenaScheduleCleanupWithPayload(arena, &logPayloadCleanupFunction, &payloads[3], sizeof(payloads[3]));
+    REQUIRE(action == (_PiggyBankArenaCleanupAction*)block2->end - 3);
+    PiggyBankArenaCancelCleanup(arena, action);
+    REQUIRE(block2->cleanupActionsBottom == block2->end);
+    REQUIRE(PiggyBankArenaScheduleCleanup(arena, &logPayloadCleanupFunction, &payloads[3]) == (_PiggyBankArenaCleanupAction*)block2->end - 1);
+
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(log == 4321);
+    REQUIRE(arena->cleanupBlocks == NULL);
+    REQUIRE(arena->heapTop == arena->start);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+TEST_CASE( "Arena generation-checked references (C)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 2*sizeof(_TestStruct)];
+    PiggyBankArena *arena = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+    REQUIRE(arena->generation == 0);
+    REQUIRE(sizeof(PiggyBankArenaRef) == 2*sizeof(unsigned int));
+
+    _TestStruct *object = (_TestStruct*) PiggyBankArenaAlloc(arena, sizeof(_TestStruct));
+    PiggyBankArenaRef ref = PiggyBankArenaMakeRef(arena, object);
+    REQUIRE(ref.offset == sizeof(PiggyBankArena));
+    REQUIRE(PiggyBankArenaResolveRef(arena, ref) == object);
+    REQUIRE(PiggyBankArenaResolveRef(arena, PiggyBankArenaMakeRef(arena, NULL)) == nullptr);
+
+    // Offsets which do not fit make NULL references instead of wrapping around
+    if (sizeof(void*) > sizeof(unsigned int)) {
+        void *far = (void*) ((uintptr_t) object + 0x100000000ULL);
+        REQUIRE(PiggyBankArenaMakeRef(arena, far).offset == 0);
+        REQUIRE(PiggyBankArenaResolveRef(arena, PiggyBankArenaMakeRef(arena, far)) == nullptr);
+    }
+    REQUIRE(PiggyBankArenaMakeRef(arena, (unsigned char*) arena - 1).offset == 0);
+
+    // After cleanup, the memory is reused but old references no longer resolve
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(arena->generation == 1);
+    REQUIRE(PiggyBankArenaAlloc(arena, sizeof(_TestStruct)) == object);
+    REQUIRE(PiggyBankArenaResolveRef(arena, ref) == nullptr);
+    REQUIRE(PiggyBankArenaResolveRef(arena, PiggyBankArenaMakeRef(arena, object)) == object);
+}
+
+TEST_CASE( "Arena splitting keeps children aligned (C)" ) {
+    unsigned long memBuffer[(sizeof(PiggyBankArena) + 1000) / sizeof(unsigned long)];
+    PiggyBankArena *parent = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(parent != nullptr);
+    REQUIRE(PiggyBankArenaAlloc(parent, 3) != nullptr);
+
+    PiggyBankArena *children[7];
+    REQUIRE(PiggyBankArenaRemainingSpace(parent) % 7 != 0);
+    REQUIRE(PiggyBankArenaSplit(parent, 7, children) == 7);
+    for (int i = 0; i < 7; i++) {
+        REQUIRE((unsigned long) ((unsigned char*) children[i] - (unsigned char*) parent) % alignof(PiggyBankArena) == 0);
+        REQUIRE(PiggyBankArenaAlloc(children[i], 1) != nullptr);
+    }
+
+    PiggyBankArenaCleanup(parent);
+}
+
+TEST_CASE( "Arena rejects NULL cleanup functions (C)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 8*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArenaInit(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int payload = 0;
+    REQUIRE(PiggyBankArenaScheduleCleanup(arena, NULL, &payload) == (_PiggyBankArenaCleanupAction*)NULL);
+    REQUIRE(PiggyBankArenaScheduleCleanupWithPayload(arena, NULL, &payload, sizeof(payload)) == (_PiggyBankArenaCleanupAction*)NULL);
+    REQUIRE(PiggyBankArenaScheduleCleanupInPhase(arena, 0, NULL, &payload) == (_PiggyBankArenaCleanupAction*)NULL);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+
+    int cleanup = 0;
+    REQUIRE(PiggyBankArenaScheduleCleanup(arena, &logCleanupFunction, &cleanup) != (_PiggyBankArenaCleanupAction*)NULL);
+    PiggyBankArenaCleanup(arena);
+    REQUIRE(cleanup == 42);
+}
\ No newline at end of file
@@ -1,5 +1,10 @@
 #define CONFIG_CATCH_MAIN
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <chrono>
+#include <memory>
+
 #include "catch2/catch_amalgamated.hpp"
 #include "PiggyBankArenaCPP.hpp"
 
@@ -13,6 +18,14 @@ struct _TestStruct {
     }
 };
 
+struct _TestCountingStruct {
+    int *destroyed;
+
+    ~_TestCountingStruct() {
+        (*destroyed)++;
+    }
+};
+
 void logCleanupFunction(void *log) {
     *(int*)log = 42;
 }
@@ -153,4 +166,487 @@ TEST_CASE( "Arena allocation of a C++ object with destructors fails properly if
     REQUIRE(arena->cleanupActionsBottom == arena->end);
 }
 
+TEST_CASE( "Arena reserve and commit (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 3*sizeof(_TestStruct)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    REQUIRE(arena->reserve(4*sizeof(_TestStruct)) == nullptr);
+    REQUIRE(arena->reserve(3*sizeof(_TestStruct)) == arena->start);
+    REQUIRE(arena->heapTop == arena->start);
+
+    REQUIRE(arena->commit(sizeof(_TestStruct)) == arena->start);
+    REQUIRE(arena->heapTop == arena->start + sizeof(_TestStruct));
+    REQUIRE(arena->reserve(3*sizeof(_TestStruct)) == nullptr);
+    REQUIRE(arena->reserve(2*sizeof(_TestStruct)) == arena->start + sizeof(_TestStruct));
+    REQUIRE(arena->commit(3*sizeof(_TestStruct)) == nullptr);
+    REQUIRE(arena->commit(0) == arena->start + sizeof(_TestStruct));
+    REQUIRE(arena->heapTop == arena->start + sizeof(_TestStruct));
+
+    arena->cleanup();
+    REQUIRE(arena->heapTop == arena->start);
+}
+
+TEST_CASE( "Arena cursor allocation (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 4*sizeof(_TestStruct)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    PiggyBankArenaCursor cursor = arena->reserveCursor(5*sizeof(_TestStruct));
+    REQUIRE(cursor.top == nullptr);
+    REQUIRE(cursor.end == nullptr);
+
+    cursor = arena->reserveCursor(3*sizeof(_TestStruct));
+    REQUIRE(cursor.arena == arena);
+    REQUIRE(cursor.top == arena->start);
+    REQUIRE(cursor.end == arena->start + 3*sizeof(_TestStruct));
+    REQUIRE(arena->heapTop == cursor.end);
+
+    REQUIRE(cursor.alloc(sizeof(_TestStruct)) == arena->start);
+    REQUIRE(cursor.alloc(sizeof(_TestStruct)) == arena->start + sizeof(_TestStruct));
+    cursor.release();
+    REQUIRE(arena->heapTop == arena->start + 2*sizeof(_TestStruct));
+
+    // Unused memory is not given back if something was allocated after the cursor
+    cursor = arena->reserveCursor(sizeof(_TestStruct));
+    REQUIRE(arena->alloc(sizeof(_TestStruct)) == arena->start + 3*sizeof(_TestStruct));
+    cursor.release();
+    REQUIRE(arena->heapTop == arena->start + 4*sizeof(_TestStruct));
+
+    arena->cleanup();
+    REQUIRE(arena->heapTop == arena->start);
+}
+
+TEST_CASE( "Child arenas (C++)" ) {
+    const unsigned long childSize = sizeof(PiggyBankArena) + sizeof(_TestCountingStruct) + sizeof(_PiggyBankArenaCleanupAction);
+    char memBuffer[sizeof(PiggyBankArena) + 2*childSize + sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *parent = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(parent != nullptr);
+
+    REQUIRE(parent->makeChild(sizeof(PiggyBankArena)) == nullptr);
+    REQUIRE(parent->heapTop == parent->start);
+
+    PiggyBankArena *child = parent->makeChild(childSize);
+    REQUIRE(child == (PiggyBankArena*) parent->start);
+    REQUIRE(child->end == parent->start + childSize);
+    REQUIRE(parent->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)parent->end - 1);
+
+    // No space left in the parent for the second child's cleanup action
+    REQUIRE(parent->makeChild(childSize) == nullptr);
+    REQUIRE(parent->heapTop == parent->start + childSize);
+
+    int destroyed = 0;
+    _TestCountingStruct *object = child->allocObject<_TestCountingStruct>();
+    REQUIRE(object == (_TestCountingStruct*) child->start);
+    object->destroyed = &destroyed;
+    child->cleanup();
+    REQUIRE(destroyed == 1);
+    REQUIRE(child->heapTop == child->start);
+
+    object = child->allocObject<_TestCountingStruct>();
+    object->destroyed = &destroyed;
+    parent->cleanup();
+    REQUIRE(destroyed == 2);
+    REQUIRE(child->cleanupActionsBottom == child->end);
+    REQUIRE(parent->heapTop == parent->start);
+    REQUIRE(parent->cleanupActionsBottom == parent->end);
+}
+
+TEST_CASE( "Arena splitting (C++)" ) {
+    const unsigned long childSize = sizeof(PiggyBankArena) + sizeof(_TestCountingStruct) + sizeof(_PiggyBankArenaCleanupAction);
+    char memBuffer[sizeof(PiggyBankArena) + sizeof(_TestStruct) + 3*(childSize + sizeof(_PiggyBankArenaCleanupAction)) + 2];
+    PiggyBankArena *parent = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(parent != nullptr);
+    REQUIRE(parent->alloc(sizeof(_TestStruct)) == parent->start);
+
+    PiggyBankArena *children[5] = {0};
+    REQUIRE(parent->split(0, children) == 0);
+    REQUIRE(parent->split(5, children) == 0);
+    REQUIRE(children[0] == nullptr);
+    REQUIRE(parent->heapTop == parent->start + sizeof(_TestStruct));
+
+    REQUIRE(parent->split(3, children) == 3);
+    REQUIRE(parent->remainingSpace() == 2);
+    int destroyed = 0;
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(children[i] == (PiggyBankArena*) (parent->start + sizeof(_TestStruct) + i*childSize));
+        REQUIRE(children[i]->end == (unsigned char*) children[i] + childSize);
+        _TestCountingStruct *object = children[i]->allocObject<_TestCountingStruct>();
+        REQUIRE(object != nullptr);
+        object->destroyed = &destroyed;
+    }
+
+    parent->cleanup();
+    REQUIRE(destroyed == 3);
+    REQUIRE(parent->heapTop == parent->start);
+    REQUIRE(parent->cleanupActionsBottom == parent->end);
+}
+
+TEST_CASE( "Arena adopting other arenas (C++)" ) {
+    char ownerBuffer[sizeof(PiggyBankArena) + 3*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *owner = PiggyBankArena::init(ownerBuffer, sizeof(ownerBuffer));
+    REQUIRE(owner != nullptr);
+
+    PiggyBankArena *workers[2];
+    int destroyed = 0;
+    for (int i = 0; i < 2; i++) {
+        const unsigned long size = sizeof(PiggyBankArena) + sizeof(_TestCountingStruct) + sizeof(_PiggyBankArenaCleanupAction);
+        workers[i] = PiggyBankArena::init(malloc(size), size);
+        REQUIRE(workers[i] != nullptr);
+        _TestCountingStruct *object = workers[i]->allocObject<_TestCountingStruct>();
+        REQUIRE(object != nullptr);
+        object->destroyed = &destroyed;
+    }
+
+    REQUIRE(owner->adopt(workers[0], &free) == (_PiggyBankArenaCleanupAction*)owner->end - 2);
+    // Not enough space for both cleanup actions
+    REQUIRE(owner->adopt(workers[1], &free) == nullptr);
+    REQUIRE(owner->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)owner->end - 2);
+    REQUIRE(owner->adopt(workers[1]) == (_PiggyBankArenaCleanupAction*)owner->end - 3);
+
+    owner->cleanup();
+    REQUIRE(destroyed == 2);
+    REQUIRE(owner->cleanupActionsBottom == owner->end);
+    free(workers[1]);
+}
+
+TEST_CASE( "Arena deferred function objects (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 8*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int log = 0;
+    int first = 1;
+    long second = 2;
+    int *logPointer = &log;
+    auto lambda1 = [logPointer, first, second] { *logPointer = *logPointer * 100 + first * 10 + (int) second; };
+    REQUIRE(arena->defer(lambda1) == (_PiggyBankArenaCleanupAction*)arena->end - 4);
+    REQUIRE(arena->scheduleCleanup(&logCleanupFunction, &log) == (_PiggyBankArenaCleanupAction*)arena->end - 5);
+
+    int payload[2] = {3, 4};
+    REQUIRE(arena->scheduleCleanupWithPayload([](void *values) { ((int*)values)[0] += ((int*)values)[1]; }, payload, sizeof(payload)) != nullptr);
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 8);
+    REQUIRE(arena->defer([&log] { log = 0; }) == nullptr);
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 8);
+
+    arena->cleanup();
+    REQUIRE(log == 4212);
+    REQUIRE(payload[0] == 3);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+struct _TestOrderStruct {
+    int *log;
+    int value;
+
+    ~_TestOrderStruct() {
+        *log = *log * 10 + value;
+    }
+};
+
+TEST_CASE( "Arena array allocation (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 3*sizeof(_TestOrderStruct) + 3*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    REQUIRE(arena->allocArray<_TestOrderStruct>(4) == nullptr);
+    REQUIRE(arena->allocArray<_TestOrderStruct>(~0UL) == nullptr);
+    REQUIRE(arena->heapTop == arena->start);
+
+    int log = 0;
+    _TestOrderStruct *objects = arena->allocArray<_TestOrderStruct>(3);
+    REQUIRE(objects == (_TestOrderStruct*) arena->start);
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 3);
+    for (int i = 0; i < 3; i++) {
+        objects[i].log = &log;
+        objects[i].value = i + 1;
+    }
+
+    arena->cleanup();
+    REQUIRE(log == 321);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+
+    // No space for the cleanup action
+    REQUIRE(arena->alloc(1) == arena->start);
+    REQUIRE(arena->allocArray<_TestOrderStruct>(3) == nullptr);
+    REQUIRE(arena->heapTop == arena->start + 1);
+    REQUIRE(arena->allocArray<_TestOrderStruct>(3, false) == (_TestOrderStruct*) (arena->start + 1));
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+TEST_CASE( "Arena grouped object allocation (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 4*sizeof(_TestOrderStruct) + sizeof(_TestCountingStruct) + 9*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int log = 0;
+    _TestOrderStruct *objects[4];
+    for (int i = 0; i < 3; i++) {
+        objects[i] = arena->allocObjectGrouped<_TestOrderStruct>();
+        REQUIRE(objects[i] == (_TestOrderStruct*) arena->start + i);
+        REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 3);
+        objects[i]->log = &log;
+        objects[i]->value = i + 1;
+    }
+
+    // Objects of another type, or which are not adjacent to the group, start a new group
+    int destroyed = 0;
+    _TestCountingStruct *other = arena->allocObjectGrouped<_TestCountingStruct>();
+    REQUIRE(other == (_TestCountingStruct*) (arena->start + 3*sizeof(_TestOrderStruct)));
+    other->destroyed = &destroyed;
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 6);
+    objects[3] = arena->allocObjectGrouped<_TestOrderStruct>();
+    REQUIRE(objects[3] != nullptr);
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 9);
+    objects[3]->log = &log;
+    objects[3]->value = 4;
+
+    REQUIRE(arena->allocObjectGrouped<_TestOrderStruct>() == nullptr);
+
+    arena->cleanup();
+    REQUIRE(log == 4321);
+    REQUIRE(destroyed == 1);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+static unsigned long _benchmarkDestroyedValues = 0;
+
+struct _BenchmarkStruct {
+    unsigned long value;
+
+    ~_BenchmarkStruct() {
+        _benchmarkDestroyedValues += value;
+    }
+};
+
+template <bool grouped> double _benchmarkCleanupSeconds(PiggyBankArena *arena, unsigned long objectCount) {
+    double best = 0;
+    for (int repetition = 0; repetition < 10; repetition++) {
+        for (unsigned long i = 0; i < objectCount; i++) {
+            if (grouped) {
+                arena->allocObjectGrouped<_BenchmarkStruct>()->value = i;
+            } else {
+                arena->allocObject<_BenchmarkStruct>()->value = i;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        arena->cleanup();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (repetition == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+
+    return best;
+}
+
+TEST_CASE( "Arena cleanup throughput with 1M objects (C++)", "[.][benchmark]" ) {
+    const unsigned long objectCount = 1000000;
+    const unsigned long size = sizeof(PiggyBankArena) + objectCount * (sizeof(_BenchmarkStruct) + sizeof(_PiggyBankArenaCleanupAction));
+    void *memory = malloc(size);
+    PiggyBankArena *arena = PiggyBankArena::init(memory, size);
+    REQUIRE(arena != nullptr);
+
+    double seconds = _benchmarkCleanupSeconds<false>(arena, objectCount);
+    double groupedSeconds = _benchmarkCleanupSeconds<true>(arena, objectCount);
+    WARN("cleanup of 1M objects allocated with allocObject: " << seconds * 1000 << " ms (" << objectCount / seconds / 1e6 << " M objects/s)");
+    REQUIRE(_benchmarkDestroyedValues == 20 * (objectCount * (objectCount - 1) / 2));
+    WARN("cleanup of 1M objects allocated with allocObjectGrouped: " << groupedSeconds * 1000 << " ms (" << objectCount / groupedSeconds / 1e6 << " M objects/s)");
+
+    free(memory);
+}
+
+TEST_CASE( "Arena cancelling cleanup actions (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 8*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int cleanup1 = 0;
+    int cleanup2 = 0;
+    int cleanup3 = 0;
+
+    _PiggyBankArenaCleanupAction *action1 = arena->scheduleCleanup(&logCleanupFunction, &cleanup1);
+    _PiggyBankArenaCleanupAction *action2 = arena->defer([&cleanup2] { cleanup2 = 42; });
+    _PiggyBankArenaCleanupAction *action3 = arena->scheduleIndependentCleanup(&logCleanupFunction, &cleanup3);
+    REQUIRE(action3 == (_PiggyBankArenaCleanupAction*)arena->end - 7);
+
+    // Cancelling an action in the middle of the stack only disables it
+    arena->cancelCleanup(action2);
+    REQUIRE(action2->func == nullptr);
+    REQUIRE(arena->cleanupActionsBottom == action3);
+
+    // Cancelling the most recent action pops it, along with the cancelled actions below it
+    arena->cancelCleanup(action3);
+    REQUIRE(arena->cleanupActionsBottom == action1);
+
+    arena->cleanup();
+    REQUIRE(cleanup1 == 42);
+    REQUIRE(cleanup2 == 0);
+    REQUIRE(cleanup3 == 0);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+struct _TestLogEntry {
+    int *log;
+    int value;
+};
+
+void logEntryCleanupFunction(void *entry) {
+    *((_TestLogEntry*) entry)->log = *((_TestLogEntry*) entry)->log * 10 + ((_TestLogEntry*) entry)->value;
+}
+
+TEST_CASE( "Arena cleanup phases (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 20*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int log = 0;
+    _TestLogEntry entries[6] = {{&log, 1}, {&log, 2}, {&log, 3}, {&log, 4}, {&log, 5}, {&log, 6}};
+
+    REQUIRE(arena->scheduleCleanup(&logEntryCleanupFunction, &entries[0], PIGGYBANKARENA_CLEANUP_PHASES) == nullptr);
+    REQUIRE(arena->scheduleCleanup(&logEntryCleanupFunction, &entries[0], 1) == (_PiggyBankArenaCleanupAction*)arena->end - 2);
+    REQUIRE(arena->scheduleCleanup(&logEntryCleanupFunction, &entries[1]) == (_PiggyBankArenaCleanupAction*)arena->end - 4);
+    REQUIRE(arena->scheduleCleanup(&logEntryCleanupFunction, &entries[2], 0));
+    REQUIRE(arena->scheduleCleanup(&logEntryCleanupFunction, &entries[3], 1));
+    REQUIRE(arena->scheduleCleanup(&logEntryCleanupFunction, &entries[4], 0));
+
+    // Cancelled phased actions are skipped, but their space is not given back
+    _PiggyBankArenaCleanupAction *cancelled = arena->scheduleCleanup(&logEntryCleanupFunction, &entries[5], 0);
+    REQUIRE(cancelled == (_PiggyBankArenaCleanupAction*)arena->end - 15);
+    arena->cancelCleanup(cancelled);
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 16);
+
+    arena->cleanup();
+    REQUIRE(log == 53412);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+    for (int phase = 0; phase < PIGGYBANKARENA_CLEANUP_PHASES; phase++) {
+        REQUIRE(arena->cleanupPhases[phase] == nullptr);
+    }
+}
+
+TEST_CASE( "Arena cleanup blocks (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 2*sizeof(_TestOrderStruct) + 3*sizeof(_PiggyBankArenaCleanupAction)];
+    char blockBuffer1[sizeof(_PiggyBankArenaCleanupBlock) + 4*sizeof(_PiggyBankArenaCleanupAction)];
+    char blockBuffer2[sizeof(_PiggyBankArenaCleanupBlock) + sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int log = 0;
+    _TestOrderStruct *object = arena->allocObject<_TestOrderStruct>();
+    REQUIRE(object != nullptr);
+    object->log = &log;
+    object->value = 1;
+
+    REQUIRE(arena->addCleanupBlock(blockBuffer1, sizeof(_PiggyBankArenaCleanupBlock)) == nullptr);
+    _PiggyBankArenaCleanupBlock *block1 = arena->addCleanupBlock(blockBuffer1, sizeof(blockBuffer1));
+    REQUIRE(block1 == (_PiggyBankArenaCleanupBlock*) blockBuffer1);
+    REQUIRE(arena->cleanupBlocks == block1);
+
+    // Cleanup actions go into the block, leaving the arena's space for the heap
+    _TestOrderStruct *objects = arena->allocArray<_TestOrderStruct>(1);
+    REQUIRE(objects != nullptr);
+    REQUIRE(block1->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)block1->end - 3);
+    objects[0].log = &log;
+    objects[0].value = 2;
+    REQUIRE(arena->alloc(arena->remainingSpace()) != nullptr);
+    REQUIRE(arena->defer([&log] { log = log * 10 + 3; }) == nullptr);
+
+    _PiggyBankArenaCleanupBlock *block2 = arena->addCleanupBlock(blockBuffer2, sizeof(blockBuffer2));
+    REQUIRE(block2->previous == block1);
+    REQUIRE(arena->scheduleCleanup(&logCleanupFunction, &log) == (_PiggyBankArenaCleanupAction*)block2->end - 1);
+
+    arena->cleanup();
+    REQUIRE(log == 4221);
+    REQUIRE(arena->cleanupBlocks == nullptr);
+    REQUIRE(arena->heapTop == arena->start);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+TEST_CASE( "Arena generation-checked references (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 2*sizeof(_TestStruct)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+    REQUIRE(arena->generation == 0);
+    REQUIRE(sizeof(ArenaRef<_TestStruct>) == 2*sizeof(unsigned int));
+
+    _TestStruct *object = arena->allocObject<_TestStruct>(false);
+    ArenaRef<_TestStruct> ref = arena->makeRef(object);
+    REQUIRE(arena->resolve(ref) == object);
+    REQUIRE(arena->resolve(arena->makeRef<_TestStruct>(nullptr)) == nullptr);
+
+    // Offsets which do not fit make NULL references instead of wrapping around
+    if (sizeof(void*) > sizeof(unsigned int)) {
+        _TestStruct *far = (_TestStruct*) ((uintptr_t) object + 0x100000000ULL);
+        REQUIRE(arena->makeRef(far).offset == 0);
+        REQUIRE(arena->resolve(arena->makeRef(far)) == nullptr);
+    }
+
+    // After cleanup, the memory is reused but old references no longer resolve
+    arena->cleanup();
+    REQUIRE(arena->generation == 1);
+    REQUIRE(arena->allocObject<_TestStruct>(false) == object);
+    REQUIRE(arena->resolve(ref) == nullptr);
+    REQUIRE(arena->resolve(arena->makeRef(object)) == object);
+    arena->cleanup();
+    arena->cleanup();
+    REQUIRE(arena->generation == 3);
+}
+
+TEST_CASE( "Arena splitting keeps children aligned (C++)" ) {
+    alignas(PiggyBankArena) unsigned char memBuffer[sizeof(PiggyBankArena) + 1000];
+    PiggyBankArena *parent = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(parent != nullptr);
+    REQUIRE(parent->alloc(3) != nullptr);
+
+    PiggyBankArena *children[7];
+    REQUIRE(parent->remainingSpace() % 7 != 0);
+    REQUIRE(parent->split(7, children) == 7);
+    for (int i = 0; i < 7; i++) {
+        REQUIRE((unsigned long) ((unsigned char*) children[i] - memBuffer) % alignof(PiggyBankArena) == 0);
+        REQUIRE(children[i]->allocObject<_TestStruct>() != nullptr);
+    }
+
+    parent->cleanup();
+}
+
+TEST_CASE( "Arena rejects NULL cleanup functions (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 8*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int payload = 0;
+    REQUIRE(arena->scheduleCleanup(nullptr, &payload) == nullptr);
+    REQUIRE(arena->scheduleCleanup(nullptr, &payload, 0) == nullptr);
+    REQUIRE(arena->scheduleIndependentCleanup(nullptr, &payload) == nullptr);
+    REQUIRE(arena->scheduleCleanupWithPayload(nullptr, &payload, sizeof(payload)) == nullptr);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+
+    int cleanup = 0;
+    REQUIRE(arena->scheduleCleanup(&logCleanupFunction, &cleanup) != nullptr);
+    arena->cleanup();
+    REQUIRE(cleanup == 42);
+}
+
+TEST_CASE( "Arena cancelling deferred function objects (C++)" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 8*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int log = 0;
+    std::shared_ptr<int> state = std::make_shared<int>(1);
+    auto lambda = [state, &log] { log += *state; };
+    _PiggyBankArenaCleanupAction *action = arena->defer(lambda);
+    REQUIRE(action != nullptr);
+    REQUIRE(state.use_count() == 3);
+
+    // The stored copy is destroyed without being called, and its space is given back
+    arena->cancelDeferred<decltype(lambda)>(action);
+    REQUIRE(state.use_count() == 2);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+
+    arena->cleanup();
+    REQUIRE(log == 0);
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,753 @@
+#define CONFIG_CATCH_MAIN
+
+#include <stdlib.h>
+#include <ostream>
+#include <string>
+
+#include "catch2/catch_amalgamated.hpp"
+#include "PiggyBankArenaContainersCPP.hpp"
+
+namespace PiggyBankArena {
+
+struct _TestCountedStruct {
+    int *destroyed;
+    int value;
+
+    _TestCountedStruct(int *destroyed, int value) : destroyed(destroyed), value(value) {}
+
+    _TestCountedStruct(_TestCountedStruct&& other) : destroyed(other.destroyed), value(other.value) {
+        other.destroyed = nullptr;
+    }
+
+    ~_TestCountedStruct() {
+        if (destroyed != nullptr) {
+            (*destroyed)++;
+        }
+    }
+};
+
+TEST_CASE( "Arena vector grows in place" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 64*sizeof(int)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    ArenaVector<int> vector(arena);
+    REQUIRE(vector.size() == 0);
+    REQUIRE(arena->heapTop == arena->start);
+
+    // While the vector is the topmost allocation, growing it never moves it
+    REQUIRE(vector.pushBack(0));
+    int *data = vector.data();
+    REQUIRE(data == (int*) arena->start);
+    REQUIRE(vector.capacity() == 4);
+    for (int i = 1; i < 64; i++) {
+        REQUIRE(vector.pushBack(i));
+        REQUIRE(vector.data() == data);
+    }
+
+    REQUIRE(vector.size() == 64);
+    REQUIRE(vector.capacity() == 64);
+    REQUIRE(arena->remainingSpace() == 0);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+    for (int i = 0; i < 64; i++) {
+        REQUIRE(vector[i] == i);
+    }
+
+    // When the arena is full, the vector cannot grow
+    REQUIRE(!vector.pushBack(64));
+    REQUIRE(vector.size() == 64);
+
+    arena->cleanup();
+}
+
+TEST_CASE( "Arena vector copies when not on top" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 64*sizeof(int)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    ArenaVector<int> vector(arena);
+    REQUIRE(vector.reserve(2));
+    REQUIRE(vector.capacity() == 2);
+    REQUIRE(vector.pushBack(1));
+    REQUIRE(vector.pushBack(2));
+
+    // Something else is allocated after the vector, so it must move to grow
+    int *data = vector.data();
+    REQUIRE(arena->alloc(sizeof(int)) == data + 2);
+    REQUIRE(vector.pushBack(3));
+    REQUIRE(vector.data() == data + 3);
+    REQUIRE(vector.capacity() == 4);
+    REQUIRE(arena->heapTop == (unsigned char*) (data + 7));
+
+    int sum = 0;
+    for (int value : vector) {
+        sum = sum * 10 + value;
+    }
+    REQUIRE(sum == 123);
+
+    // Growth falls back to the minimum if there is no room to double
+    REQUIRE(arena->alloc(50 * sizeof(int)) != nullptr);
+    REQUIRE(vector.pushBack(4));
+    REQUIRE(vector.pushBack(5));
+    REQUIRE(vector.capacity() == 5);
+    REQUIRE(vector.data() == data + 57);
+    REQUIRE(arena->remainingSpace() == 2 * sizeof(int));
+
+    arena->cleanup();
+}
+
+TEST_CASE( "Arena vector destroys its elements on cleanup" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 26*sizeof(_TestCountedStruct) + 6*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int destroyed = 0;
+    ArenaVector<_TestCountedStruct> vector(arena);
+    for (int i = 0; i < 6; i++) {
+        REQUIRE(vector.emplaceBack(&destroyed, i) != nullptr);
+    }
+
+    // All elements share one cleanup action, growing in place keeps it
+    REQUIRE(vector.capacity() == 8);
+    REQUIRE(arena->cleanupActionsBottom == ((_PiggyBankArenaCleanupAction*) arena->end) - 3);
+
+    // Popping destroys right away and is not repeated on cleanup
+    vector.popBack();
+    REQUIRE(destroyed == 1);
+    REQUIRE(vector.size() == 5);
+
+    // Moving to a new buffer destroys the old elements and reuses the cleanup action for the new ones
+    REQUIRE(arena->alloc(sizeof(_TestCountedStruct)) != nullptr);
+    for (int i = 5; i < 9; i++) {
+        REQUIRE(vector.emplaceBack(&destroyed, i) != nullptr);
+    }
+    REQUIRE(arena->cleanupActionsBottom == ((_PiggyBankArenaCleanupAction*) arena->end) - 3);
+    REQUIRE(vector.capacity() == 16);
+    REQUIRE(destroyed == 1);
+    for (int i = 0; i < 9; i++) {
+        REQUIRE(vector[i].value == i);
+    }
+
+    // Clearing destroys right away and keeps the capacity
+    vector.clear();
+    REQUIRE(destroyed == 10);
+    REQUIRE(vector.size() == 0);
+    REQUIRE(vector.capacity() == 16);
+
+    arena->cleanup();
+    REQUIRE(destroyed == 10);
+}
+
+TEST_CASE( "Arena segmented vector keeps element addresses stable" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 256*sizeof(int)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    ArenaSegmentedVector<int, 16> vector(arena);
+    REQUIRE(vector.size() == 0);
+    REQUIRE(vector.chunkCount() == 0);
+
+    int *addresses[100];
+    for (int i = 0; i < 100; i++) {
+        addresses[i] = vector.emplaceBack(i);
+        REQUIRE(addresses[i] != nullptr);
+    }
+
+    REQUIRE(vector.size() == 100);
+    REQUIRE(vector.chunkCount() == 7);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(&vector[i] == addresses[i]);
+        REQUIRE(vector[i] == i);
+    }
+
+    // Elements within a chunk are contiguous
+    REQUIRE(addresses[15] == addresses[0] + 15);
+
+    // Running out of space fails without losing any elements
+    while (vector.pushBack(0)) {}
+    unsigned long size = vector.size();
+    REQUIRE(!vector.pushBack(0));
+    REQUIRE(vector.size() == size);
+    REQUIRE(vector.chunkCount() * 16 == size);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(vector[i] == i);
+    }
+
+    arena->cleanup();
+}
+
+TEST_CASE( "Arena segmented vector destroys its elements on cleanup" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 32*sizeof(_TestCountedStruct) + 16*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int destroyed = 0;
+    ArenaSegmentedVector<_TestCountedStruct, 4> vector(arena);
+    for (int i = 0; i < 10; i++) {
+        REQUIRE(vector.emplaceBack(&destroyed, i) != nullptr);
+    }
+
+    // One cleanup action per chunk, and nothing is moved or destroyed while growing
+    REQUIRE(vector.chunkCount() == 3);
+    REQUIRE(arena->cleanupActionsBottom == ((_PiggyBankArenaCleanupAction*) arena->end) - 9);
+    REQUIRE(destroyed == 0);
+
+    arena->cleanup();
+    REQUIRE(destroyed == 10);
+}
+
+TEST_CASE( "Arena hash map" ) {
+    unsigned long memSize = sizeof(PiggyBankArena) + 256 * 1024;
+    char *memBuffer = (char*) malloc(memSize);
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, memSize);
+    REQUIRE(arena != nullptr);
+
+    ArenaHashMap<int, int> map(arena);
+    REQUIRE(map.size() == 0);
+    REQUIRE(map.capacity() == 0);
+    REQUIRE(map.find(1) == nullptr);
+    REQUIRE(!map.erase(1));
+
+    for (int i = 0; i < 1000; i++) {
+        int *value = map.insert(i * 7, i);
+        REQUIRE(value != nullptr);
+        REQUIRE(*value == i);
+    }
+
+    REQUIRE(map.size() == 1000);
+    REQUIRE(map.capacity() >= 1000);
+    REQUIRE((map.capacity() & (map.capacity() - 1)) == 0);
+    for (int i = 0; i < 1000; i++) {
+        REQUIRE(map.find(i * 7) != nullptr);
+        REQUIRE(*map.find(i * 7) == i);
+        REQUIRE(map.find(i * 7 + 1) == nullptr);
+    }
+
+    // Inserting an existing key keeps the existing value
+    REQUIRE(*map.insert(7, 100) == 1);
+    REQUIRE(map.size() == 1000);
+
+    for (int i = 0; i < 1000; i += 2) {
+        REQUIRE(map.erase(i * 7));
+        REQUIRE(!map.erase(i * 7));
+    }
+
+    REQUIRE(map.size() == 500);
+    for (int i = 0; i < 1000; i++) {
+        REQUIRE((map.find(i * 7) != nullptr) == (i % 2 == 1));
+    }
+
+    // Erased slots are reused, repeated churn does not grow the table
+    unsigned long capacity = map.capacity();
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE(map.insert(i * 7, round) != nullptr);
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE(map.erase(i * 7));
+        }
+    }
+    REQUIRE(map.capacity() == capacity);
+    for (int i = 1; i < 1000; i += 2) {
+        REQUIRE(*map.find(i * 7) == i);
+    }
+
+    arena->cleanup();
+    free(memBuffer);
+}
+
+TEST_CASE( "Arena hash map destroys its entries on cleanup" ) {
+    unsigned long memSize = sizeof(PiggyBankArena) + 64 * 1024;
+    char *memBuffer = (char*) malloc(memSize);
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, memSize);
+    REQUIRE(arena != nullptr);
+
+    int destroyed = 0;
+    ArenaHashMap<std::string, _TestCountedStruct> map(arena);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(map.emplace(std::to_string(i), &destroyed, i) != nullptr);
+    }
+
+    // Growing moves the entries, and the old tables are no longer destroyed on cleanup
+    REQUIRE(destroyed == 0);
+    REQUIRE(arena->cleanupActionsBottom->func != nullptr);
+    REQUIRE(arena->cleanupActionsBottom[1].func == nullptr);
+    REQUIRE(map.find("42")->value == 42);
+
+    REQUIRE(map.erase("42"));
+    REQUIRE(destroyed == 1);
+    REQUIRE(map.find("42") == nullptr);
+
+    arena->cleanup();
+    REQUIRE(destroyed == 100);
+    free(memBuffer);
+}
+
+TEST_CASE( "Arena hash map fails without space" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 512];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    // 16 slots of 8 bytes, 16 control bytes and the table record fit, 32 slots do not
+    ArenaHashMap<int, int> map(arena);
+    int count = 0;
+    while (map.insert(count, count) != nullptr) {
+        count++;
+    }
+
+    REQUIRE(count == 14);
+    REQUIRE(map.capacity() == 16);
+    for (int i = 0; i < count; i++) {
+        REQUIRE(*map.find(i) == i);
+    }
+
+    arena->cleanup();
+}
+
+TEST_CASE( "Byte hashing" ) {
+    const char text[] = "The quick brown fox jumps over the lazy dog, and then it jumps over the lazy dog once more.";
+
+    // Every length takes a different path through the hash function
+    unsigned long long hashes[sizeof(text)];
+    for (unsigned long length = 0; length < sizeof(text); length++) {
+        hashes[length] = hashBytes(text, length);
+        REQUIRE(hashes[length] == hashBytes(text, length));
+        REQUIRE(hashes[length] != hashBytes(text, length, 1));
+        for (unsigned long other = 0; other < length; other++) {
+            REQUIRE(hashes[length] != hashes[other]);
+        }
+    }
+
+    // Changing any single byte changes the hash
+    char copy[sizeof(text)];
+    memcpy(copy, text, sizeof(text));
+    for (unsigned long i = 0; i < sizeof(text) - 1; i++) {
+        copy[i] ^= 1;
+        REQUIRE(hashBytes(copy, sizeof(text) - 1) != hashes[sizeof(text) - 1]);
+        copy[i] ^= 1;
+    }
+}
+
+TEST_CASE( "Arena string interning" ) {
+    unsigned long memSize = sizeof(PiggyBankArena) + 256 * 1024;
+    char *memBuffer = (char*) malloc(memSize);
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, memSize);
+    REQUIRE(arena != nullptr);
+
+    ArenaStringInterner interner(arena);
+    REQUIRE(interner.find("hello").data() == nullptr);
+
+    std::string hello = "hello";
+    std::string_view interned = interner.intern(hello);
+    REQUIRE(interned == "hello");
+    REQUIRE(interned.data() != hello.data());
+    REQUIRE(interned.data()[5] == 0);
+    REQUIRE((unsigned char*) interned.data() >= arena->start);
+    REQUIRE((unsigned char*) interned.data() < arena->heapTop);
+
+    // The same characters always give the same view
+    REQUIRE(interner.intern("hello").data() == interned.data());
+    REQUIRE(interner.find(std::string("hel") + "lo").data() == interned.data());
+    REQUIRE(interner.intern("hell").data() != interned.data());
+    REQUIRE(interner.intern("").data() != nullptr);
+    REQUIRE(interner.size() == 3);
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 1000; i++) {
+            REQUIRE(interner.intern("identifier" + std::to_string(i)) == "identifier" + std::to_string(i));
+        }
+    }
+    REQUIRE(interner.size() == 1003);
+
+    // No space is used when interning fails
+    while (arena->alloc(1) != nullptr) {}
+    arena->heapTop -= 4;
+    unsigned char *heapTop = arena->heapTop;
+    REQUIRE(interner.intern("too long").data() == nullptr);
+    REQUIRE(arena->heapTop == heapTop);
+    REQUIRE(interner.find("too long").data() == nullptr);
+    REQUIRE(interner.intern("hello").data() == interned.data());
+
+    arena->cleanup();
+    free(memBuffer);
+}
+
+TEST_CASE( "Arena string builder" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 1024];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    ArenaStringBuilder builder(arena);
+    REQUIRE(builder.view().empty());
+
+    REQUIRE(builder.append("value="));
+    REQUIRE(builder.appendInteger(-1234567890123LL));
+    REQUIRE(builder.appendChar(','));
+    REQUIRE(builder.appendUnsigned(18446744073709551615ULL));
+    REQUIRE(builder.appendChar(','));
+    REQUIRE(builder.appendInteger(-9223372036854775807LL - 1));
+    REQUIRE(builder.appendChar(','));
+    REQUIRE(builder.appendInteger(0));
+    REQUIRE(builder.appendChar(','));
+    REQUIRE(builder.appendFloat(3.25));
+    REQUIRE(builder.appendChar(','));
+    REQUIRE(builder.appendFloat(1.0 / 3.0, 3));
+    REQUIRE(builder.appendFormat(" [%s:%04d]", "x", 42));
+    REQUIRE(builder.view() == "value=-1234567890123,18446744073709551615,-9223372036854775808,0,3.25,0.333 [x:0042]");
+
+    // The string is written at the start of the heap and grows in place
+    const char *data = builder.view().data();
+    REQUIRE(data == (char*) arena->start);
+    for (int i = 0; i < 20; i++) {
+        REQUIRE(builder.append("0123456789"));
+    }
+    REQUIRE(builder.view().data() == data);
+
+    // Finishing gives the unused capacity back
+    unsigned long size = builder.size();
+    std::string_view result = builder.finish();
+    REQUIRE(result.data() == data);
+    REQUIRE(result.size() == size);
+    REQUIRE(result.data()[size] == 0);
+    REQUIRE(arena->heapTop == (unsigned char*) data + size + 1);
+    REQUIRE(builder.size() == 0);
+
+    // Once something else is allocated, the next growth copies the string
+    REQUIRE(builder.append("abc"));
+    REQUIRE(builder.view().data() == data + size + 1);
+    void *other = arena->alloc(1);
+    REQUIRE(other != nullptr);
+    REQUIRE(builder.appendFormat("%0100d", 7));
+    REQUIRE(builder.view().data() == (char*) other + 1);
+    REQUIRE(builder.view().substr(0, 4) == "abc0");
+    REQUIRE(builder.size() == 103);
+
+    // Nothing is appended when there is no space left, and the formatted text is not truncated
+    unsigned long remaining = arena->remainingSpace() + (unsigned long) (((char*) arena->heapTop) - builder.view().data()) - builder.size();
+    REQUIRE(!builder.appendFormat("%0*d", (int) remaining + 1, 1));
+    REQUIRE(builder.size() == 103);
+    REQUIRE(builder.appendFormat("%0*d", (int) remaining - 1, 1));
+    REQUIRE(builder.size() == 102 + remaining);
+    REQUIRE(!builder.appendInteger(-12));
+    REQUIRE(builder.size() == 102 + remaining);
+    REQUIRE(builder.finish().data() != nullptr);
+    REQUIRE(arena->remainingSpace() == 0);
+
+    arena->cleanup();
+}
+
+TEST_CASE( "Arena string builder as a stream buffer" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 256];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    ArenaStringBuilder builder(arena);
+    ArenaStringStreamBuffer buffer(&builder);
+    std::ostream stream(&buffer);
+    stream << "pi is about " << 3.14 << " and " << 42 << '!';
+    REQUIRE(stream.good());
+    REQUIRE(builder.finish() == "pi is about 3.14 and 42!");
+
+    // The stream fails once the arena is full
+    for (int i = 0; i < 100 && stream.good(); i++) {
+        stream << "0123456789";
+    }
+    REQUIRE(stream.bad());
+
+    arena->cleanup();
+}
+
+struct _TestNode {
+    OffsetPtr<_TestNode> next;
+    OffsetPtr<const char> name;
+    int value;
+};
+
+struct _TestRoot {
+    OffsetPtr<_TestNode> list;
+    OffsetVector<OffsetPtr<_TestNode>> index;
+    OffsetVector<int> numbers;
+};
+
+TEST_CASE( "Offset pointers" ) {
+    int values[2] = { 1, 2 };
+    OffsetPtr<int> pointer;
+    REQUIRE(!pointer);
+    REQUIRE(pointer.get() == nullptr);
+
+    pointer = values;
+    REQUIRE(pointer);
+    REQUIRE(*pointer == 1);
+    REQUIRE(pointer[1] == 2);
+
+    // Copies point to the same target from their own location
+    OffsetPtr<int> copy = pointer;
+    REQUIRE(copy.get() == values);
+    OffsetPtr<int> copies[2];
+    copies[1] = copy;
+    REQUIRE(copies[1].get() == values);
+    REQUIRE(!copies[0]);
+
+    copy = nullptr;
+    REQUIRE(copy.get() == nullptr);
+}
+
+TEST_CASE( "Offset data structures can be moved as a whole" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 4096];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    // The root is the first allocation and starts out zeroed
+    _TestRoot *root = arena->allocArray<_TestRoot>(1, false);
+    REQUIRE(root != nullptr);
+    memset((void*) root, 0, sizeof(_TestRoot));
+
+    const char *names[3] = { "one", "two", "three" };
+    for (int i = 0; i < 3; i++) {
+        _TestNode *node = arena->allocArray<_TestNode>(1, false);
+        REQUIRE(node != nullptr);
+        char *name = (char*) arena->alloc(strlen(names[i]) + 1);
+        memcpy(name, names[i], strlen(names[i]) + 1);
+        new (node) _TestNode();
+        node->name = name;
+        node->value = i + 1;
+        node->next = root->list;
+        root->list = node;
+        REQUIRE(root->index.pushBack(arena, root->list));
+    }
+
+    // Numbers grow in place while they are on top, and are copied otherwise
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(root->numbers.pushBack(arena, i));
+    }
+    REQUIRE(root->numbers.count == 100);
+    REQUIRE(root->index.count == 3);
+
+    // Copy the used part of the arena elsewhere and drop the original
+    unsigned long used = (unsigned long) (arena->heapTop - arena->start);
+    char *copy = (char*) malloc(used);
+    memcpy(copy, arena->start, used);
+    memset(arena->start, 0xAB, used);
+
+    _TestRoot *copiedRoot = (_TestRoot*) copy;
+    int sum = 0;
+    for (_TestNode *node = copiedRoot->list.get(); node != nullptr; node = node->next.get()) {
+        REQUIRE((char*) node >= copy);
+        REQUIRE((char*) node < copy + used);
+        sum = sum * 10 + node->value;
+    }
+    REQUIRE(sum == 321);
+    REQUIRE(strcmp(copiedRoot->index[0]->name.get(), "one") == 0);
+    REQUIRE(strcmp(copiedRoot->index[2]->name.get(), "three") == 0);
+    REQUIRE(copiedRoot->index[1]->next.get() == copiedRoot->index[0].get());
+
+    int expected = 0;
+    for (int number : copiedRoot->numbers) {
+        REQUIRE(number == expected++);
+    }
+    REQUIRE(expected == 100);
+
+    free(copy);
+    arena->cleanup();
+}
+
+struct _TestGraphNode {
+    _TestGraphNode *next;
+    _TestGraphNode *other;
+    char *name;
+    std::string label;
+    int *destroyed;
+
+    _TestGraphNode(int *destroyed) : next(nullptr), other(nullptr), name(nullptr), destroyed(destroyed) {}
+
+    _TestGraphNode(_TestGraphNode&& node) : next(node.next), other(node.other), name(node.name), label(std::move(node.label)), destroyed(node.destroyed) {}
+
+    ~_TestGraphNode() {
+        (*destroyed)++;
+    }
+
+    void trace(ArenaPromoter& promoter) {
+        this->next = promoter.promote(this->next);
+        this->other = promoter.promote(this->other);
+        this->name = promoter.promoteArray(this->name, strlen(this->name) + 1);
+    }
+};
+
+TEST_CASE( "Arena promotion" ) {
+    unsigned long memSize = sizeof(PiggyBankArena) + 16 * 1024 * 1024;
+    char *requestBuffer = (char*) malloc(memSize);
+    char *longBuffer = (char*) malloc(memSize);
+    PiggyBankArena *request = PiggyBankArena::init(requestBuffer, memSize);
+    PiggyBankArena *longLived = PiggyBankArena::init(longBuffer, memSize);
+    REQUIRE(request != nullptr);
+    REQUIRE(longLived != nullptr);
+
+    // A long list whose nodes also point back to the head, with one node outside of the request arena
+    int destroyed = 0;
+    _TestGraphNode outside(&destroyed);
+    outside.name = (char*) "outside";
+    _TestGraphNode *head = nullptr;
+    for (int i = 0; i < 10000; i++) {
+        _TestGraphNode *node = new (request->allocObject<_TestGraphNode>()) _TestGraphNode(&destroyed);
+        node->name = (char*) request->alloc(16);
+        snprintf(node->name, 16, "node%d", i);
+        node->label = std::string(40, 'a' + i % 26);
+        node->next = head;
+        head = node;
+    }
+    for (_TestGraphNode *node = head; node != nullptr; node = node->next) {
+        node->other = node->next != nullptr ? head : &outside;
+    }
+    _TestGraphNode *unreachable = new (request->allocObject<_TestGraphNode>()) _TestGraphNode(&destroyed);
+    unreachable->name = (char*) "unreachable";
+
+    ArenaPromoter promoter(request, longLived);
+    _TestGraphNode *promoted = promoter.promote(head);
+    REQUIRE(!promoter.failed());
+    REQUIRE(promoted != head);
+    REQUIRE(promoter.promote(head) == promoted);
+    REQUIRE(promoter.promote(&outside) == &outside);
+    REQUIRE(promoter.promote<_TestGraphNode>(nullptr) == nullptr);
+    REQUIRE(destroyed == 0);
+
+    // The request arena can now be wiped, destroying the moved-from originals
+    request->cleanup();
+    REQUIRE(destroyed == 10001);
+    memset(requestBuffer, 0xAB, memSize);
+
+    int count = 0;
+    for (_TestGraphNode *node = promoted; node != nullptr; node = node->next) {
+        int index = 9999 - count;
+        REQUIRE((char*) node >= longBuffer);
+        REQUIRE((char*) node < longBuffer + memSize);
+        REQUIRE(node->name >= longBuffer);
+        REQUIRE(node->name < longBuffer + memSize);
+        REQUIRE(strcmp(node->name, ("node" + std::to_string(index)).c_str()) == 0);
+        REQUIRE(node->label == std::string(40, 'a' + index % 26));
+        REQUIRE(node->other == (node->next != nullptr ? promoted : &outside));
+        count++;
+    }
+    REQUIRE(count == 10000);
+
+    // Promoted objects are destroyed along with the long-lived arena
+    longLived->cleanup();
+    REQUIRE(destroyed == 20001);
+
+    free(requestBuffer);
+    free(longBuffer);
+}
+
+TEST_CASE( "Arena promotion fails without space" ) {
+    char requestBuffer[sizeof(PiggyBankArena) + 4096];
+    char longBuffer[sizeof(PiggyBankArena) + 3*sizeof(int)];
+    PiggyBankArena *request = PiggyBankArena::init(requestBuffer, sizeof(requestBuffer));
+    PiggyBankArena *longLived = PiggyBankArena::init(longBuffer, sizeof(longBuffer));
+
+    int *numbers = (int*) request->alloc(4 * sizeof(int));
+    ArenaPromoter promoter(request, longLived);
+    REQUIRE(promoter.promoteArray(numbers, 4) == nullptr);
+    REQUIRE(promoter.failed());
+
+    request->cleanup();
+    longLived->cleanup();
+}
+
+struct _TestRingNode {
+    _TestRingNode *peer;
+    int value;
+
+    void trace(ArenaPromoter& promoter) {
+        this->peer = promoter.promote(this->peer);
+    }
+};
+
+TEST_CASE( "Arena promotion forwards pointers into promoted arrays" ) {
+    char requestBuffer[sizeof(PiggyBankArena) + 64 * 1024];
+    char longBuffer[sizeof(PiggyBankArena) + 4096];
+    PiggyBankArena *request = PiggyBankArena::init(requestBuffer, sizeof(requestBuffer));
+    PiggyBankArena *longLived = PiggyBankArena::init(longBuffer, sizeof(longBuffer));
+
+    // Each element points to the next one, so all but the last point into the middle of the array
+    _TestRingNode *ring = request->allocArray<_TestRingNode>(4);
+    for (int i = 0; i < 4; i++) {
+        ring[i].peer = &ring[(i + 1) % 4];
+        ring[i].value = i;
+    }
+    _TestRingNode *single = request->allocArray<_TestRingNode>(1);
+    single->peer = &ring[2];
+    single->value = 42;
+
+    ArenaPromoter promoter(request, longLived);
+    _TestRingNode *promoted = promoter.promoteArray(ring, 4);
+    REQUIRE(promoted != nullptr);
+    _TestRingNode *promotedSingle = promoter.promote(single);
+    REQUIRE(!promoter.failed());
+    REQUIRE(promoter.promote(&ring[3]) == &promoted[3]);
+    REQUIRE(promoter.promote(&ring[1].value) == &promoted[1].value);
+
+    request->cleanup();
+    memset(requestBuffer, 0xAB, sizeof(requestBuffer));
+
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(promoted[i].value == i);
+        REQUIRE(promoted[i].peer == &promoted[(i + 1) % 4]);
+    }
+    REQUIRE(promotedSingle->peer == &promoted[2]);
+    REQUIRE(promotedSingle->value == 42);
+
+    // Only the array and the single object were copied
+    REQUIRE(longLived->heapTop == longLived->start + 5 * sizeof(_TestRingNode));
+
+    longLived->cleanup();
+}
+
+TEST_CASE( "Arena vector keeps grouped objects out of its cleanup action" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 16*sizeof(_TestCountedStruct) + 6*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    // A grouped object right after a full vector must not be counted as one of its elements
+    int destroyed = 0;
+    ArenaVector<_TestCountedStruct> vector(arena);
+    REQUIRE(vector.reserve(4));
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(vector.emplaceBack(&destroyed, i) != nullptr);
+    }
+    _TestCountedStruct *grouped = arena->allocObjectGrouped<_TestCountedStruct>();
+    REQUIRE(grouped == vector.data() + 4);
+    new (grouped) _TestCountedStruct(&destroyed, 42);
+
+    REQUIRE(vector.emplaceBack(&destroyed, 4) != nullptr);
+    REQUIRE(vector.data() != grouped - 4);
+    vector.popBack();
+    REQUIRE(destroyed == 1);
+
+    arena->cleanup();
+    REQUIRE(destroyed == 6);
+}
+
+TEST_CASE( "Arena vector can push its own elements while moving" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 16*sizeof(std::string) + 64 + 4*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    ArenaVector<std::string> vector(arena);
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(vector.pushBack(std::string(40, 'a' + i)));
+    }
+
+    // The copy is made before the old buffer's elements are moved and destroyed
+    REQUIRE(arena->alloc(sizeof(std::string)) != nullptr);
+    std::string *data = vector.data();
+    REQUIRE(vector.pushBack(vector[0]));
+    REQUIRE(vector.data() != data);
+    REQUIRE(vector.size() == 5);
+    REQUIRE(vector[4] == std::string(40, 'a'));
+    REQUIRE(vector[0] == std::string(40, 'a'));
+    REQUIRE(vector.emplaceBack(vector[3]) != nullptr);
+    REQUIRE(vector[5] == std::string(40, 'd'));
+
+    arena->cleanup();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,605 @@
+#define CONFIG_CATCH_MAIN
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <thread>
+
+#include "catch2/catch_amalgamated.hpp"
+#include "PiggyBankArenaPosixCPP.hpp"
+
+namespace PiggyBankArena {
+
+static bool _isOpen(int fd) {
+    return fcntl(fd, F_GETFD) != -1;
+}
+
+static bool _isMapped(void* start, unsigned long length) {
+    return msync(start, length, MS_ASYNC) == 0;
+}
+
+TEST_CASE( "Arena closes grouped file descriptors" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 6*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int fds[4];
+    for (int i = 0; i < 4; i++) {
+        fds[i] = open("/dev/null", O_RDONLY);
+        REQUIRE(fds[i] >= 0);
+    }
+
+    // Consecutive file descriptors share one cleanup action, in either direction
+    REQUIRE(fds[1] == fds[0] + 1);
+    REQUIRE(scheduleClose(arena, fds[1]));
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 3);
+    REQUIRE(scheduleClose(arena, fds[0]));
+    REQUIRE(scheduleClose(arena, fds[2]));
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 3);
+
+    // File descriptors which are not consecutive get a new cleanup action
+    int gap = fds[3] + 10;
+    while (_isOpen(gap) || _isOpen(gap + 1)) {
+        gap++;
+    }
+    REQUIRE(dup2(fds[3], gap) == gap);
+    REQUIRE(dup2(fds[3], gap + 1) == gap + 1);
+    REQUIRE(scheduleClose(arena, gap));
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 6);
+    REQUIRE(scheduleClose(arena, gap + 1));
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 6);
+    REQUIRE(!scheduleClose(arena, gap + 10));
+
+    arena->cleanup();
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(!_isOpen(fds[i]));
+    }
+    REQUIRE(!_isOpen(gap));
+    REQUIRE(!_isOpen(gap + 1));
+    REQUIRE(_isOpen(fds[3]));
+    close(fds[3]);
+}
+
+TEST_CASE( "Arena unmaps grouped mappings" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 6*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    const unsigned long pageSize = sysconf(_SC_PAGESIZE);
+    unsigned char *memory = (unsigned char*) mmap(nullptr, 4*pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(memory != MAP_FAILED);
+
+    // Adjacent mappings share one cleanup action, in either direction
+    REQUIRE(scheduleUnmap(arena, memory + pageSize, pageSize));
+    REQUIRE(scheduleUnmap(arena, memory, pageSize));
+    REQUIRE(scheduleUnmap(arena, memory + 2*pageSize, pageSize));
+    REQUIRE(arena->cleanupActionsBottom == (_PiggyBankArenaCleanupAction*)arena->end - 3);
+
+    arena->cleanup();
+    REQUIRE(!_isMapped(memory, 3*pageSize));
+    REQUIRE(_isMapped(memory + 3*pageSize, pageSize));
+    munmap(memory + 3*pageSize, pageSize);
+}
+
+TEST_CASE( "Arena output chain" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 4096];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+
+    ArenaOutputChain chain(arena);
+    REQUIRE(chain.count() == 0);
+    REQUIRE(chain.writeTo(fds[1]));
+
+    // Fragments which follow each other in memory are merged
+    char *header = (char*) arena->alloc(8);
+    memcpy(header, "HTTP/1.1", 8);
+    char *status = (char*) arena->alloc(7);
+    memcpy(status, " 200 OK", 7);
+    REQUIRE(chain.append(header, 8));
+    REQUIRE(chain.append(status, 7));
+    REQUIRE(chain.count() == 1);
+
+    static const char body[] = "\r\n\r\nhello";
+    REQUIRE(chain.append(body, sizeof(body) - 1));
+    REQUIRE(chain.append(body, 0));
+    char temporary[] = ", world";
+    REQUIRE(chain.appendCopy(temporary, sizeof(temporary) - 1));
+    temporary[0] = 'X';
+    REQUIRE(chain.count() == 3);
+    REQUIRE(chain.length() == 8 + 7 + 9 + 7);
+    REQUIRE(chain.iovecs()[1].iov_base == body);
+
+    REQUIRE(chain.writeTo(fds[1]));
+    REQUIRE(chain.count() == 0);
+    REQUIRE(chain.length() == 0);
+
+    char result[64];
+    REQUIRE(read(fds[0], result, sizeof(result)) == 31);
+    REQUIRE(memcmp(result, "HTTP/1.1 200 OK\r\n\r\nhello, world", 31) == 0);
+
+    // Writing to a closed pipe fails
+    close(fds[0]);
+    REQUIRE(chain.append(body, 4));
+    void (*previousHandler)(int) = signal(SIGPIPE, SIG_IGN);
+    REQUIRE(previousHandler != SIG_ERR);
+    bool written = chain.writeTo(fds[1]);
+    int error = errno;
+    signal(SIGPIPE, previousHandler);
+    REQUIRE(!written);
+    REQUIRE(error == EPIPE);
+    REQUIRE(chain.count() == 1);
+    REQUIRE(chain.length() == 4);
+    chain.clear();
+    REQUIRE(chain.count() == 0);
+    REQUIRE(chain.length() == 0);
+
+    close(fds[1]);
+    arena->cleanup();
+}
+
+TEST_CASE( "Arena output chain continues partial writes" ) {
+    unsigned long memSize = sizeof(PiggyBankArena) + 4 * 1024 * 1024;
+    char *memBuffer = (char*) malloc(memSize);
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, memSize);
+    REQUIRE(arena != nullptr);
+
+    // More fragments than writev accepts at once, and more data than fits into the pipe
+    ArenaOutputChain chain(arena);
+    unsigned long total = 0;
+    for (unsigned long i = 0; i < 2 * IOV_MAX; i++) {
+        unsigned long length = 1 + i % 300;
+        unsigned char *fragment = (unsigned char*) arena->alloc(length + 1);
+        for (unsigned long j = 0; j < length; j++) {
+            fragment[j] = (unsigned char) (total + j);
+        }
+        REQUIRE(chain.append(fragment, length));
+        total += length;
+    }
+    REQUIRE(chain.count() == 2 * IOV_MAX);
+
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    unsigned long received = 0;
+    bool correct = true;
+    std::thread reader([&]() {
+        unsigned char buffer[4096];
+        ssize_t count;
+        while ((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+            for (ssize_t i = 0; i < count; i++) {
+                correct = correct && buffer[i] == (unsigned char) (received + i);
+            }
+            received += (unsigned long) count;
+        }
+    });
+
+    bool written = chain.writeTo(fds[1]);
+    close(fds[1]);
+    reader.join();
+    REQUIRE(written);
+    REQUIRE(correct);
+    REQUIRE(received == total);
+    close(fds[0]);
+
+    arena->cleanup();
+    free(memBuffer);
+}
+
+TEST_CASE( "Arena output chain keeps unwritten fragments when a write would block" ) {
+    unsigned long memSize = sizeof(PiggyBankArena) + 1024 * 1024;
+    char *memBuffer = (char*) malloc(memSize);
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, memSize);
+    REQUIRE(arena != nullptr);
+
+    // More data than fits into the pipe, in fragments which are not merged
+    ArenaOutputChain chain(arena);
+    unsigned long total = 0;
+    for (int i = 0; i < 6; i++) {
+        unsigned long length = 32 * 1024;
+        unsigned char *fragment = (unsigned char*) arena->alloc(length + 1);
+        for (unsigned long j = 0; j < length; j++) {
+            fragment[j] = (unsigned char) ((total + j) % 251);
+        }
+        REQUIRE(chain.append(fragment, length));
+        total += length;
+    }
+    REQUIRE(chain.count() == 6);
+
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    REQUIRE(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+    REQUIRE(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+
+    // Each failed write leaves the rest in the chain, and retrying after draining the pipe continues where it stopped
+    unsigned long received = 0;
+    bool correct = true;
+    int blocked = 0;
+    while (true) {
+        bool written = chain.writeTo(fds[1]);
+        int error = errno;
+        if (!written) {
+            REQUIRE((error == EAGAIN || error == EWOULDBLOCK));
+            REQUIRE(chain.length() != 0);
+            REQUIRE(chain.length() < total);
+            blocked++;
+        }
+
+        unsigned char buffer[4096];
+        ssize_t count;
+        while ((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+            for (ssize_t i = 0; i < count; i++) {
+                correct = correct && buffer[i] == (unsigned char) ((received + i) % 251);
+            }
+            received += (unsigned long) count;
+        }
+
+        if (written) {
+            break;
+        }
+    }
+
+    REQUIRE(blocked > 0);
+    REQUIRE(correct);
+    REQUIRE(received == total);
+    REQUIRE(chain.count() == 0);
+    REQUIRE(chain.length() == 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    arena->cleanup();
+    free(memBuffer);
+}
+
+static void _writeTestFile(char *path, const char *contents, unsigned long length) {
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    REQUIRE(write(fd, contents, length) == (ssize_t) length);
+    close(fd);
+}
+
+TEST_CASE( "Arena reads files" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 64*1024];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    char path[] = "/tmp/PiggyBankArenaTestXXXXXX";
+    _writeTestFile(path, "line one\nline two\n", 18);
+
+    unsigned long size = 0;
+    char *contents = (char*) readFile(arena, path, &size);
+    REQUIRE(contents == (char*) arena->start);
+    REQUIRE(size == 18);
+    REQUIRE(strcmp(contents, "line one\nline two\n") == 0);
+    REQUIRE(arena->heapTop == arena->start + 19);
+
+    // Files without a size are read until their end
+    contents = (char*) readFile(arena, "/proc/self/status", &size);
+    REQUIRE(contents != nullptr);
+    REQUIRE(size > 0);
+    REQUIRE(strlen(contents) == size);
+    REQUIRE(strncmp(contents, "Name:", 5) == 0);
+    REQUIRE(arena->heapTop == (unsigned char*) contents + size + 1);
+
+    REQUIRE(readFile(arena, "/nonexistent/file", &size) == nullptr);
+    REQUIRE(errno == ENOENT);
+
+    // Nothing is allocated when the contents do not fit
+    arena->heapTop = (unsigned char*) arena->end - 18;
+    REQUIRE(readFile(arena, path, &size) == nullptr);
+    REQUIRE(errno == ENOMEM);
+    REQUIRE(readFile(arena, "/proc/self/status", &size) == nullptr);
+    REQUIRE(errno == ENOMEM);
+    REQUIRE(arena->heapTop == (unsigned char*) arena->end - 18);
+
+    unlink(path);
+    arena->cleanup();
+}
+
+TEST_CASE( "Arena maps files" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 4*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    char path[] = "/tmp/PiggyBankArenaTestXXXXXX";
+    _writeTestFile(path, "mapped contents", 15);
+    char emptyPath[] = "/tmp/PiggyBankArenaTestXXXXXX";
+    _writeTestFile(emptyPath, "", 0);
+
+    unsigned long size = 0;
+    const char *contents = (const char*) mapFile(arena, path, &size);
+    REQUIRE(contents != nullptr);
+    REQUIRE(size == 15);
+    REQUIRE(memcmp(contents, "mapped contents", 15) == 0);
+    REQUIRE(_isMapped((void*) contents, size));
+    REQUIRE(arena->heapTop == arena->start);
+
+    REQUIRE(mapFile(arena, emptyPath, &size) != nullptr);
+    REQUIRE(size == 0);
+    REQUIRE(mapFile(arena, "/nonexistent/file", &size) == nullptr);
+    REQUIRE(errno == ENOENT);
+
+    // Files which report no size without being empty are refused
+    REQUIRE(mapFile(arena, "/proc/self/status", &size) == nullptr);
+    REQUIRE(errno == EINVAL);
+    REQUIRE(mapFile(arena, "/dev/null", &size) == nullptr);
+    REQUIRE(errno == EINVAL);
+
+    // Without space for the cleanup action, the file is not mapped
+    REQUIRE(arena->alloc(arena->remainingSpace()) != nullptr);
+    REQUIRE(mapFile(arena, path, &size) == nullptr);
+    REQUIRE(errno == ENOMEM);
+
+    arena->cleanup();
+    REQUIRE(!_isMapped((void*) contents, 15));
+
+    unlink(path);
+    unlink(emptyPath);
+}
+
+struct _TestImageNode {
+    _TestImageNode *next;
+    int value;
+};
+
+static PiggyBankArena *_buildImageArena(void *memory, unsigned long size, void **pointerLocations) {
+    PiggyBankArena *arena = PiggyBankArena::init(memory, size);
+    REQUIRE(arena != nullptr);
+
+    _TestImageNode **root = (_TestImageNode**) arena->alloc(sizeof(_TestImageNode*));
+    *root = nullptr;
+    pointerLocations[0] = root;
+    for (int i = 0; i < 3; i++) {
+        _TestImageNode *node = (_TestImageNode*) arena->alloc(sizeof(_TestImageNode));
+        node->next = *root;
+        node->value = i + 1;
+        *root = node;
+        pointerLocations[i + 1] = &node->next;
+    }
+
+    return arena;
+}
+
+static int _sumImageArena(PiggyBankArena *arena) {
+    int sum = 0;
+    for (_TestImageNode *node = *(_TestImageNode**) arena->start; node != nullptr; node = node->next) {
+        REQUIRE((unsigned char*) node >= arena->start);
+        REQUIRE((unsigned char*) node < arena->heapTop);
+        sum = sum * 10 + node->value;
+    }
+    return sum;
+}
+
+TEST_CASE( "Arena images" ) {
+    char path[] = "/tmp/PiggyBankArenaTestXXXXXX";
+    _writeTestFile(path, "", 0);
+
+    // Saved from memory which stays in use, so the image is loaded elsewhere and relocated
+    unsigned long memSize = sizeof(PiggyBankArena) + 64 * 1024;
+    void *memBuffer = malloc(memSize);
+    void *pointerLocations[4];
+    PiggyBankArena *arena = _buildImageArena(memBuffer, memSize, pointerLocations);
+    unsigned long used = (unsigned long) (arena->heapTop - arena->start);
+    REQUIRE(saveImage(arena, path, pointerLocations, 4));
+
+    PiggyBankArena *loaded = loadImage(path);
+    REQUIRE(loaded != nullptr);
+    REQUIRE(loaded != arena);
+    REQUIRE(loaded->end == (unsigned char*) loaded + memSize);
+    REQUIRE(loaded->heapTop == loaded->start + used);
+    REQUIRE(loaded->remainingSpace() == arena->remainingSpace());
+    REQUIRE(_sumImageArena(loaded) == 321);
+
+    // The loaded arena can be used and cleaned up like any other, without changing the image
+    int log = 0;
+    REQUIRE(loaded->alloc(1000) != nullptr);
+    REQUIRE(loaded->scheduleCleanup([](void* log) { *(int*) log = 1; }, &log));
+    (*(_TestImageNode**) loaded->start)->value = 9;
+    unloadImage(loaded);
+    REQUIRE(log == 1);
+
+    loaded = loadImage(path);
+    REQUIRE(loaded != nullptr);
+    REQUIRE(_sumImageArena(loaded) == 321);
+    unloadImage(loaded);
+
+    // Truncated images and invalid relocations are refused instead of crashing on access
+    _PiggyBankArenaImageHeader header;
+    int fd = open(path, O_RDWR);
+    REQUIRE(fd >= 0);
+    REQUIRE(pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header));
+    unsigned long long relocation = sizeof(PiggyBankArena) + 1;
+    REQUIRE(pwrite(fd, &relocation, sizeof(relocation), (off_t) (header.dataOffset + header.used)) == (ssize_t) sizeof(relocation));
+    REQUIRE(loadImage(path) == nullptr);
+    REQUIRE(errno == EINVAL);
+    relocation = header.used;
+    REQUIRE(pwrite(fd, &relocation, sizeof(relocation), (off_t) (header.dataOffset + header.used)) == (ssize_t) sizeof(relocation));
+    REQUIRE(loadImage(path) == nullptr);
+    REQUIRE(errno == EINVAL);
+    REQUIRE(ftruncate(fd, (off_t) (header.dataOffset + header.used + sizeof(relocation))) == 0);
+    REQUIRE(loadImage(path) == nullptr);
+    REQUIRE(errno == EINVAL);
+    REQUIRE(ftruncate(fd, (off_t) header.dataOffset) == 0);
+    REQUIRE(loadImage(path) == nullptr);
+    REQUIRE(errno == EINVAL);
+    close(fd);
+
+    // Images cannot hold cleanup actions, or pointers which are misaligned or outside the heap
+    void *outside = arena->heapTop;
+    REQUIRE(!saveImage(arena, path, &outside, 1));
+    REQUIRE(errno == EINVAL);
+    void *misaligned = arena->start + 1;
+    REQUIRE(!saveImage(arena, path, &misaligned, 1));
+    REQUIRE(errno == EINVAL);
+    REQUIRE(arena->scheduleCleanup([](void*) {}, nullptr));
+    REQUIRE(!saveImage(arena, path, pointerLocations, 4));
+    REQUIRE(errno == EINVAL);
+    arena->cleanup();
+    free(memBuffer);
+
+    // Saved from memory which is gone by the time it is loaded, so the image is loaded at the same address
+    void *mapping = mmap(nullptr, memSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(mapping != MAP_FAILED);
+    arena = _buildImageArena(mapping, memSize, pointerLocations);
+    REQUIRE(saveImage(arena, path, pointerLocations, 4));
+    munmap(mapping, memSize);
+
+    loaded = loadImage(path);
+    REQUIRE(loaded == mapping);
+    REQUIRE(_sumImageArena(loaded) == 321);
+    unloadImage(loaded);
+
+    // An arena which does not start on a page boundary cannot get its address back, so it is relocated
+    mapping = mmap(nullptr, memSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(mapping != MAP_FAILED);
+    arena = _buildImageArena((unsigned char*) mapping + 64, memSize - 64, pointerLocations);
+    REQUIRE(saveImage(arena, path, pointerLocations, 4));
+    munmap(mapping, memSize);
+
+    loaded = loadImage(path);
+    REQUIRE(loaded != nullptr);
+    REQUIRE((unsigned long) loaded % sysconf(_SC_PAGESIZE) == 0);
+    REQUIRE(_sumImageArena(loaded) == 321);
+    unloadImage(loaded);
+
+    REQUIRE(loadImage("/nonexistent/file") == nullptr);
+    REQUIRE(errno == ENOENT);
+    REQUIRE(loadImage("/proc/self/status") == nullptr);
+    REQUIRE(errno == EINVAL);
+
+    unlink(path);
+}
+
+TEST_CASE( "Shared arena allocation" ) {
+    char memBuffer[sizeof(PiggyBankSharedArena) + 64];
+    REQUIRE(PiggyBankSharedArena::init(memBuffer, sizeof(PiggyBankSharedArena)) == nullptr);
+    PiggyBankSharedArena *shared = PiggyBankSharedArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(shared != nullptr);
+    REQUIRE(shared->remainingSpace() == 64);
+
+    void *first = shared->alloc(40);
+    REQUIRE(first == shared->start);
+    REQUIRE(shared->offsetOf(first) == sizeof(PiggyBankSharedArena));
+    REQUIRE(shared->at(shared->offsetOf(first)) == first);
+    REQUIRE(shared->alloc(30) == nullptr);
+    REQUIRE(shared->alloc(24) == shared->start + 40);
+    REQUIRE(shared->remainingSpace() == 0);
+
+    shared->reset();
+    REQUIRE(shared->remainingSpace() == 64);
+}
+
+TEST_CASE( "Shared arenas across processes" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 16*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    int fd = -1;
+    PiggyBankSharedArena *shared = createSharedArena(arena, 1024 * 1024, nullptr, &fd);
+    REQUIRE(shared != nullptr);
+    REQUIRE(_isOpen(fd));
+    REQUIRE(shared->remainingSpace() == 1024 * 1024 - sizeof(PiggyBankSharedArena));
+
+    // The producers map the arena again at other addresses and allocate from it concurrently
+    const int producerCount = 4;
+    const int allocationCount = 10000;
+    pid_t producers[producerCount];
+    for (int producer = 0; producer < producerCount; producer++) {
+        producers[producer] = fork();
+        REQUIRE(producers[producer] >= 0);
+        if (producers[producer] == 0) {
+            char localBuffer[sizeof(PiggyBankArena) + 4*sizeof(_PiggyBankArenaCleanupAction)];
+            PiggyBankArena *local = PiggyBankArena::init(localBuffer, sizeof(localBuffer));
+            PiggyBankSharedArena *mapped = mapSharedArena(local, fd);
+            if (mapped == nullptr || mapped == shared) {
+                _exit(1);
+            }
+
+            for (int i = 0; i < allocationCount; i++) {
+                int *block = (int*) mapped->alloc(2 * sizeof(int));
+                if (block == nullptr) {
+                    _exit(2);
+                }
+                block[0] = producer;
+                block[1] = i;
+            }
+
+            local->cleanup();
+            _exit(0);
+        }
+    }
+
+    for (int producer = 0; producer < producerCount; producer++) {
+        int status = 0;
+        REQUIRE(waitpid(producers[producer], &status, 0) == producers[producer]);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == 0);
+    }
+
+    // Every allocation got its own memory
+    REQUIRE(shared->top == sizeof(PiggyBankSharedArena) + producerCount * allocationCount * 2 * sizeof(int));
+    int next[producerCount] = { 0, 0, 0, 0 };
+    for (int *block = (int*) shared->start; block < (int*) shared->at((unsigned long) shared->top); block += 2) {
+        REQUIRE(block[0] >= 0);
+        REQUIRE(block[0] < producerCount);
+        REQUIRE(block[1] == next[block[0]]++);
+    }
+
+    arena->cleanup();
+    REQUIRE(!_isOpen(fd));
+}
+
+TEST_CASE( "Named shared arenas" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 16*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    char name[64];
+    snprintf(name, sizeof(name), "/PiggyBankArenaTest%d", (int) getpid());
+    PiggyBankSharedArena *shared = createSharedArena(arena, 4096, name);
+    REQUIRE(shared != nullptr);
+    REQUIRE(createSharedArena(arena, 4096, name) == nullptr);
+    REQUIRE(errno == EEXIST);
+
+    int *value = (int*) shared->alloc(sizeof(int));
+    *value = 42;
+
+    int fd = shm_open(name, O_RDWR, 0);
+    REQUIRE(fd >= 0);
+    PiggyBankSharedArena *opened = mapSharedArena(arena, fd);
+    close(fd);
+    REQUIRE(opened != nullptr);
+    REQUIRE(opened != shared);
+    REQUIRE(opened->remainingSpace() == shared->remainingSpace());
+    REQUIRE(*(int*) opened->at(shared->offsetOf(value)) == 42);
+
+    // Headers which do not fit the shared memory are refused
+    _PiggyBankArenaCleanupAction *bottom = arena->cleanupActionsBottom;
+    fd = shm_open(name, O_RDWR, 0);
+    REQUIRE(fd >= 0);
+    shared->size = 8192;
+    REQUIRE(mapSharedArena(arena, fd) == nullptr);
+    REQUIRE(errno == EINVAL);
+    shared->size = 4096;
+    shared->top = 4097;
+    REQUIRE(mapSharedArena(arena, fd) == nullptr);
+    REQUIRE(errno == EINVAL);
+    shared->top = 0;
+    REQUIRE(mapSharedArena(arena, fd) == nullptr);
+    REQUIRE(errno == EINVAL);
+    REQUIRE(arena->cleanupActionsBottom == bottom);
+    close(fd);
+
+    REQUIRE(createSharedArena(arena, sizeof(PiggyBankSharedArena)) == nullptr);
+    REQUIRE(errno == EINVAL);
+
+    REQUIRE(shm_unlink(name) == 0);
+    arena->cleanup();
+}
+
+}
\ No newline at end of file
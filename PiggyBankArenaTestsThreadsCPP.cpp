@@ -0,0 +1,182 @@
+#define CONFIG_CATCH_MAIN
+
+#include <stdlib.h>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+#include "PiggyBankArenaThreadsCPP.hpp"
+
+namespace PiggyBankArena {
+
+struct _TestThreadStruct {
+    std::thread::id *log;
+
+    ~_TestThreadStruct() {
+        *log = std::this_thread::get_id();
+    }
+};
+
+TEST_CASE( "Arena reclaimer cleans up arenas on a background thread" ) {
+    char memBuffers[3][sizeof(PiggyBankArena) + sizeof(_TestThreadStruct) + sizeof(_PiggyBankArenaCleanupAction)];
+    std::thread::id logs[3];
+    PiggyBankArena *arenas[3];
+
+    PiggyBankArenaReclaimer reclaimer;
+    REQUIRE(reclaimer.acquire() == nullptr);
+
+    for (int i = 0; i < 3; i++) {
+        arenas[i] = PiggyBankArena::init(memBuffers[i], sizeof(memBuffers[i]));
+        REQUIRE(arenas[i] != nullptr);
+        _TestThreadStruct *object = arenas[i]->allocObject<_TestThreadStruct>();
+        REQUIRE(object != nullptr);
+        object->log = &logs[i];
+        reclaimer.reclaim(arenas[i]);
+    }
+
+    reclaimer.waitIdle();
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(logs[i] != std::thread::id());
+        REQUIRE(logs[i] != std::this_thread::get_id());
+    }
+
+    bool acquired[3] = {false, false, false};
+    for (int i = 0; i < 3; i++) {
+        PiggyBankArena *arena = reclaimer.acquire();
+        REQUIRE(arena != nullptr);
+        REQUIRE(arena->heapTop == arena->start);
+        REQUIRE(arena->cleanupActionsBottom == arena->end);
+        for (int j = 0; j < 3; j++) {
+            if (arena == arenas[j]) {
+                acquired[j] = true;
+            }
+        }
+    }
+
+    REQUIRE(acquired[0]);
+    REQUIRE(acquired[1]);
+    REQUIRE(acquired[2]);
+    REQUIRE(reclaimer.acquire() == nullptr);
+}
+
+TEST_CASE( "Arena reclaimer cleans up pending arenas before it is destroyed" ) {
+    char memBuffer[sizeof(PiggyBankArena) + sizeof(_TestThreadStruct) + sizeof(_PiggyBankArenaCleanupAction)];
+    std::thread::id log;
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+    _TestThreadStruct *object = arena->allocObject<_TestThreadStruct>();
+    REQUIRE(object != nullptr);
+    object->log = &log;
+
+    {
+        PiggyBankArenaReclaimer reclaimer;
+        reclaimer.reclaim(arena);
+    }
+
+    REQUIRE(log != std::thread::id());
+    REQUIRE(log != std::this_thread::get_id());
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+struct _TestCleanupLog {
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<std::thread::id> threads;
+};
+
+struct _TestCleanupEntry {
+    _TestCleanupLog *log;
+    int value;
+};
+
+void logCleanupEntry(void *argument) {
+    _TestCleanupEntry *entry = (_TestCleanupEntry*) argument;
+    std::lock_guard<std::mutex> lock(entry->log->mutex);
+    entry->log->order.push_back(entry->value);
+    entry->log->threads.push_back(std::this_thread::get_id());
+}
+
+TEST_CASE( "Arena independent cleanup actions run in order with a normal cleanup" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 8*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    _TestCleanupLog log;
+    _TestCleanupEntry entries[3] = {{&log, 1}, {&log, 2}, {&log, 3}};
+    REQUIRE(arena->scheduleIndependentCleanup(&logCleanupEntry, &entries[0]) == (_PiggyBankArenaCleanupAction*)arena->end - 3);
+    REQUIRE(arena->scheduleCleanup(&logCleanupEntry, &entries[1]) == (_PiggyBankArenaCleanupAction*)arena->end - 4);
+    REQUIRE(arena->scheduleIndependentCleanup(&logCleanupEntry, &entries[2]) == (_PiggyBankArenaCleanupAction*)arena->end - 7);
+    REQUIRE(arena->scheduleIndependentCleanup(&logCleanupEntry, &entries[2]) == nullptr);
+
+    arena->cleanup();
+    REQUIRE(log.order == std::vector<int>({3, 2, 1}));
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+TEST_CASE( "Arena parallel cleanup" ) {
+    const int count = 1000;
+    const unsigned long size = sizeof(PiggyBankArena) + 2*count*3*sizeof(_PiggyBankArenaCleanupAction);
+    void *memory = malloc(size);
+    PiggyBankArena *arena = PiggyBankArena::init(memory, size);
+    REQUIRE(arena != nullptr);
+
+    _TestCleanupLog log;
+    std::vector<_TestCleanupEntry> entries(2*count);
+    for (int i = 0; i < 2*count; i++) {
+        entries[i].log = &log;
+        entries[i].value = i;
+        if (i % 2 == 0) {
+            REQUIRE(arena->scheduleIndependentCleanup(&logCleanupEntry, &entries[i]));
+        } else {
+            REQUIRE(arena->scheduleCleanup(&logCleanupEntry, &entries[i]));
+        }
+    }
+
+    parallelCleanup(arena, 4);
+    REQUIRE(arena->heapTop == arena->start);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+    REQUIRE(log.order.size() == 2*count);
+
+    // Independent actions run first, on all of the threads, followed by ordered actions in LIFO order on the calling thread
+    std::vector<bool> seen(2*count);
+    for (int i = 0; i < count; i++) {
+        REQUIRE(log.order[i] % 2 == 0);
+        seen[log.order[i]] = true;
+    }
+    for (int i = 0; i < count; i++) {
+        REQUIRE(log.order[count + i] == 2*count - 1 - 2*i);
+        REQUIRE(log.threads[count + i] == std::this_thread::get_id());
+    }
+    for (int i = 0; i < 2*count; i += 2) {
+        REQUIRE(seen[i]);
+    }
+
+    std::vector<std::thread::id> threads(log.threads.begin(), log.threads.begin() + count);
+    std::sort(threads.begin(), threads.end());
+    REQUIRE(std::unique(threads.begin(), threads.end()) - threads.begin() == 4);
+
+    free(memory);
+}
+
+TEST_CASE( "Arena parallel cleanup runs phases first" ) {
+    char memBuffer[sizeof(PiggyBankArena) + 16*sizeof(_PiggyBankArenaCleanupAction)];
+    PiggyBankArena *arena = PiggyBankArena::init(memBuffer, sizeof(memBuffer));
+    REQUIRE(arena != nullptr);
+
+    _TestCleanupLog log;
+    _TestCleanupEntry entries[4] = {{&log, 1}, {&log, 2}, {&log, 3}, {&log, 4}};
+    REQUIRE(arena->scheduleIndependentCleanup(&logCleanupEntry, &entries[0]));
+    REQUIRE(arena->scheduleCleanup(&logCleanupEntry, &entries[1]));
+    REQUIRE(arena->scheduleCleanup(&logCleanupEntry, &entries[2], 1));
+    REQUIRE(arena->scheduleCleanup(&logCleanupEntry, &entries[3], 0));
+
+    parallelCleanup(arena, 2);
+    REQUIRE(log.order == std::vector<int>({4, 3, 1, 2}));
+    REQUIRE(arena->cleanupPhases[0] == nullptr);
+    REQUIRE(arena->cleanupPhases[1] == nullptr);
+    REQUIRE(arena->cleanupActionsBottom == arena->end);
+}
+
+}
\ No newline at end of file
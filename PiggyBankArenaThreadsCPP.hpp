@@ -0,0 +1,151 @@
+/// PiggyBankArena: Allocate memory into a block which you free all at once.
+/// Multithreading utilities for the C++ version of the library.
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PiggyBankArenaCPP.hpp"
+
+namespace PiggyBankArena {
+
+/// @brief A background thread which cleans up arenas handed over to it and keeps them in a pool for reuse.
+/// @remark This takes running cleanup actions (e.g. many destructors) off of latency-sensitive threads: handing over an arena is O(1).
+class PiggyBankArenaReclaimer {
+public:
+    PiggyBankArenaReclaimer() : _stopping(false), _busy(false), _thread(&PiggyBankArenaReclaimer::_run, this) {}
+
+    /// @brief Stops the background thread after all arenas that were handed over have been cleaned up.
+    ~PiggyBankArenaReclaimer() {
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_stopping = true;
+        }
+
+        this->_wakeUp.notify_one();
+        this->_thread.join();
+    }
+
+    PiggyBankArenaReclaimer(const PiggyBankArenaReclaimer&) = delete;
+    PiggyBankArenaReclaimer& operator=(const PiggyBankArenaReclaimer&) = delete;
+
+    /// @brief Hand over an arena to be cleaned up on the background thread. Afterwards it is put into the pool of clean arenas.
+    /// @param arena A pointer to the arena. It must not be used until it is handed out again by acquire().
+    inline void reclaim(struct PiggyBankArena* arena) {
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_pending.push_back(arena);
+        }
+
+        this->_wakeUp.notify_one();
+    }
+
+    /// @brief Take a clean arena out of the pool.
+    /// @returns a pointer to a clean arena, or NULL if the pool is empty.
+    inline struct PiggyBankArena* acquire() {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (this->_pool.empty()) {
+            return nullptr;
+        }
+
+        struct PiggyBankArena* result = this->_pool.back();
+        this->_pool.pop_back();
+        return result;
+    }
+
+    /// @brief Block until all arenas that were handed over have been cleaned up and put into the pool.
+    inline void waitIdle() {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        this->_idle.wait(lock, [this] { return this->_pending.empty() && !this->_busy; });
+    }
+
+private:
+    inline void _run() {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        while (true) {
+            this->_wakeUp.wait(lock, [this] { return this->_stopping || !this->_pending.empty(); });
+            if (this->_pending.empty()) {
+                return;
+            }
+
+            std::vector<struct PiggyBankArena*> batch;
+            batch.swap(this->_pending);
+            this->_busy = true;
+            lock.unlock();
+
+            for (struct PiggyBankArena* arena : batch) {
+                arena->cleanup();
+            }
+
+            lock.lock();
+            this->_pool.insert(this->_pool.end(), batch.begin(), batch.end());
+            this->_busy = false;
+            this->_idle.notify_all();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    std::condition_variable _idle;
+    std::vector<struct PiggyBankArena*> _pending;
+    std::vector<struct PiggyBankArena*> _pool;
+    bool _stopping;
+    bool _busy;
+    std::thread _thread;
+};
+
+/// @brief Clean up an arena like cleanup() does, but run its independent cleanup actions (see scheduleIndependentCleanup) on multiple threads.
+/// @remark Phased cleanup actions run first on the calling thread, as with cleanup(). The independent cleanup actions run next, split evenly across the threads. Afterwards, all other cleanup actions run on the calling thread in last-in-first-out order.
+/// @param arena A pointer to the arena.
+/// @param threadCount The number of threads to use, including the calling thread.
+inline void parallelCleanup(struct PiggyBankArena* arena, unsigned int threadCount) {
+    arena->_runCleanupPhases();
+
+    std::vector<struct _PiggyBankArenaCleanupAction*> independentActions;
+    auto collectIndependentActions = [&independentActions] (struct _PiggyBankArenaCleanupAction* action, void* end) {
+        while (action < end) {
+            if (action->func == &PiggyBankArena::_runIndependentCleanup) {
+                independentActions.push_back(action);
+            }
+
+            action = PiggyBankArena::_nextCleanupAction(action);
+        }
+    };
+
+    for (struct _PiggyBankArenaCleanupBlock* block = arena->cleanupBlocks; block != nullptr; block = block->previous) {
+        collectIndependentActions(block->cleanupActionsBottom, block->end);
+    }
+    collectIndependentActions(arena->cleanupActionsBottom, arena->end);
+
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    unsigned long chunkSize = (independentActions.size() + threadCount - 1) / threadCount;
+    auto runChunk = [&independentActions, chunkSize] (unsigned long chunk) {
+        unsigned long chunkEnd = (chunk + 1) * chunkSize < independentActions.size() ? (chunk + 1) * chunkSize : independentActions.size();
+        for (unsigned long i = chunk * chunkSize; i < chunkEnd; i++) {
+            independentActions[i]->func(independentActions[i]->argument);
+            // Skip the action (and its payload) when the rest of the arena is cleaned up
+            independentActions[i]->func = nullptr;
+            independentActions[i]->argument = nullptr;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int thread = 1; thread < threadCount && thread * chunkSize < independentActions.size(); thread++) {
+        threads.emplace_back(runChunk, thread);
+    }
+
+    runChunk(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    arena->cleanup();
+}
+
+}
\ No newline at end of file
@@ -1,3 +1,3 @@
 #!/bin/sh
-g++ -static PiggyBankArenaTestsC.cpp PiggyBankArenaTestsCPP.cpp catch2/catch_amalgamated.cpp -I. -o run_test
+g++ -static PiggyBankArenaTestsC.cpp PiggyBankArenaTestsCPP.cpp PiggyBankArenaTestsThreadsCPP.cpp PiggyBankArenaTestsContainersCPP.cpp PiggyBankArenaTestsPosixCPP.cpp catch2/catch_amalgamated.cpp -I. -pthread -o run_test
 ./run_test
\ No newline at end of file
@@ -1,2 +1,2 @@
-g++ -static PiggyBankArenaTestsC.cpp PiggyBankArenaTestsCPP.cpp catch2\catch_amalgamated.cpp -I. -o run_test.exe
+g++ -static PiggyBankArenaTestsC.cpp PiggyBankArenaTestsCPP.cpp PiggyBankArenaTestsThreadsCPP.cpp PiggyBankArenaTestsContainersCPP.cpp catch2\catch_amalgamated.cpp -I. -o run_test.exe
 run_test.exe
\ No newline at end of file